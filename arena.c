@@ -0,0 +1,151 @@
+/* Copyright (c) 2026 Dennis Wölfing
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* arena.c
+ * Arena allocator.
+ */
+
+#include <config.h>
+#include <err.h>
+#include <stdalign.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+// Blocks start small because most commands and functions are short and grow
+// for larger ones.
+#define MIN_BLOCK_SIZE 1024
+#define MAX_BLOCK_SIZE 65536
+
+struct ArenaBlock {
+    struct ArenaBlock* next;
+    alignas(max_align_t) char data[];
+};
+
+struct ArenaRelease {
+    struct ArenaRelease* next;
+    void (*release)(void*);
+    void* object;
+};
+
+static void* allocate(struct Arena* arena, size_t size, size_t alignment);
+
+void* arenaAllocate(struct Arena* arena, size_t size) {
+    return allocate(arena, size, alignof(max_align_t));
+}
+
+void arenaAddToArray(struct Arena* arena, void** array, size_t* used,
+        const void* value, size_t size) {
+    // The capacity of the array is not stored. Instead arrays always have room
+    // for the next power of two elements.
+    size_t count = *used;
+    if (count == 0 || (count >= 4 && (count & (count - 1)) == 0)) {
+        size_t capacity = count == 0 ? 4 : 2 * count;
+        void* newArray = arenaAllocate(arena, capacity * size);
+        if (count > 0) {
+            memcpy(newArray, *array, count * size);
+        }
+        *array = newArray;
+    }
+
+    memcpy((char*) *array + count * size, value, size);
+    (*used)++;
+}
+
+void arenaDefer(struct Arena* arena, void (*release)(void*), void* object) {
+    struct ArenaRelease* entry = arenaAllocate(arena,
+            sizeof(struct ArenaRelease));
+    entry->release = release;
+    entry->object = object;
+    entry->next = arena->releases;
+    arena->releases = entry;
+}
+
+char* arenaStrdup(struct Arena* arena, const char* string) {
+    return arenaStrndup(arena, string, strlen(string));
+}
+
+char* arenaStrndup(struct Arena* arena, const char* string, size_t length) {
+    char* result = allocate(arena, length + 1, 1);
+    memcpy(result, string, length);
+    result[length] = '\0';
+    return result;
+}
+
+void freeArena(struct Arena* arena) {
+    for (struct ArenaRelease* entry = arena->releases; entry;
+            entry = entry->next) {
+        entry->release(entry->object);
+    }
+
+    struct ArenaBlock* block = arena->blocks;
+    while (block) {
+        struct ArenaBlock* next = block->next;
+        free(block);
+        block = next;
+    }
+    initArena(arena);
+}
+
+void initArena(struct Arena* arena) {
+    arena->blocks = NULL;
+    arena->releases = NULL;
+    arena->next = NULL;
+    arena->remaining = 0;
+    arena->blockSize = 0;
+}
+
+static void* allocate(struct Arena* arena, size_t size, size_t alignment) {
+    size_t padding = -(uintptr_t) arena->next & (alignment - 1);
+
+    if (padding + size > arena->remaining) {
+        // Large allocations get their own block so that the rest of the
+        // current block is not wasted.
+        size_t blockSize = arena->blockSize;
+        if (blockSize < MAX_BLOCK_SIZE) {
+            blockSize = blockSize ? 2 * blockSize : MIN_BLOCK_SIZE;
+        }
+        bool large = size > blockSize / 4;
+        if (large) {
+            blockSize = size;
+        } else {
+            arena->blockSize = blockSize;
+        }
+
+        struct ArenaBlock* block = malloc(sizeof(struct ArenaBlock) +
+                blockSize);
+        if (!block) err(1, "malloc");
+
+        if (large && arena->blocks) {
+            block->next = arena->blocks->next;
+            arena->blocks->next = block;
+            return block->data;
+        }
+
+        block->next = arena->blocks;
+        arena->blocks = block;
+        arena->next = block->data;
+        arena->remaining = blockSize;
+        padding = 0;
+    }
+
+    void* result = arena->next + padding;
+    arena->next += padding + size;
+    arena->remaining -= padding + size;
+    return result;
+}
@@ -0,0 +1,45 @@
+/* Copyright (c) 2026 Dennis Wölfing
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* arena.h
+ * Arena allocator.
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+struct ArenaBlock;
+struct ArenaRelease;
+
+struct Arena {
+    struct ArenaBlock* blocks;
+    struct ArenaRelease* releases;
+    char* next;
+    size_t remaining;
+    size_t blockSize;
+};
+
+void* arenaAllocate(struct Arena* arena, size_t size);
+void arenaAddToArray(struct Arena* arena, void** array, size_t* used,
+        const void* value, size_t size);
+void arenaDefer(struct Arena* arena, void (*release)(void*), void* object);
+char* arenaStrdup(struct Arena* arena, const char* string);
+char* arenaStrndup(struct Arena* arena, const char* string, size_t length);
+void freeArena(struct Arena* arena);
+void initArena(struct Arena* arena);
+
+#endif
@@ -0,0 +1,549 @@
+/* Copyright (c) 2026 Dennis Wölfing
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* arith.c
+ * Arithmetic expansion.
+ */
+
+#include <config.h>
+#include <ctype.h>
+#include <err.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "arith.h"
+#include "variables.h"
+
+enum Operator {
+    OP_NONE,
+    OP_END,
+    OP_INVALID,
+    OP_NUMBER,
+    OP_NAME,
+    OP_LPAREN,
+    OP_RPAREN,
+    OP_ASSIGN,
+    OP_QUESTION,
+    OP_COLON,
+    OP_INCREMENT,
+    OP_DECREMENT,
+    OP_NOT,
+    OP_COMPLEMENT,
+    OP_COMMA,
+    OP_OR,
+    OP_AND,
+    OP_BITOR,
+    OP_XOR,
+    OP_BITAND,
+    OP_EQ,
+    OP_NE,
+    OP_LT,
+    OP_LE,
+    OP_GT,
+    OP_GE,
+    OP_SHL,
+    OP_SHR,
+    OP_ADD,
+    OP_SUB,
+    OP_MUL,
+    OP_DIV,
+    OP_MOD,
+};
+
+enum NodeType {
+    NODE_NUMBER,
+    NODE_VARIABLE,
+    NODE_UNARY,
+    NODE_BINARY,
+    NODE_CONDITIONAL,
+    NODE_ASSIGN,
+    NODE_INCREMENT,
+};
+
+struct Arithmetic {
+    enum NodeType type;
+    // For assignments the operator that is applied to the old value, or
+    // OP_NONE. Increments use OP_ADD and OP_SUB.
+    enum Operator op;
+    bool postfix;
+    intmax_t value;
+    const char* name;
+    struct Arithmetic* operands[3];
+};
+
+struct Parser {
+    struct Arena* arena;
+    const char* text;
+    const char* next;
+    bool quiet;
+    // The current token.
+    enum Operator token;
+    enum Operator assignOp;
+    intmax_t value;
+    const char* name;
+    size_t nameLength;
+};
+
+static const struct {
+    const char* text;
+    enum Operator token;
+    enum Operator assignOp;
+} operators[] = {
+    { "<<=", OP_ASSIGN, OP_SHL }, { ">>=", OP_ASSIGN, OP_SHR },
+    { "<<", OP_SHL, OP_NONE }, { ">>", OP_SHR, OP_NONE },
+    { "<=", OP_LE, OP_NONE }, { ">=", OP_GE, OP_NONE },
+    { "==", OP_EQ, OP_NONE }, { "!=", OP_NE, OP_NONE },
+    { "&&", OP_AND, OP_NONE }, { "||", OP_OR, OP_NONE },
+    { "*=", OP_ASSIGN, OP_MUL }, { "/=", OP_ASSIGN, OP_DIV },
+    { "%=", OP_ASSIGN, OP_MOD }, { "+=", OP_ASSIGN, OP_ADD },
+    { "-=", OP_ASSIGN, OP_SUB }, { "&=", OP_ASSIGN, OP_BITAND },
+    { "^=", OP_ASSIGN, OP_XOR }, { "|=", OP_ASSIGN, OP_BITOR },
+    { "++", OP_INCREMENT, OP_NONE }, { "--", OP_DECREMENT, OP_NONE },
+    { "=", OP_ASSIGN, OP_NONE }, { "*", OP_MUL, OP_NONE },
+    { "/", OP_DIV, OP_NONE }, { "%", OP_MOD, OP_NONE },
+    { "+", OP_ADD, OP_NONE }, { "-", OP_SUB, OP_NONE },
+    { "<", OP_LT, OP_NONE }, { ">", OP_GT, OP_NONE },
+    { "&", OP_BITAND, OP_NONE }, { "^", OP_XOR, OP_NONE },
+    { "|", OP_BITOR, OP_NONE }, { "!", OP_NOT, OP_NONE },
+    { "~", OP_COMPLEMENT, OP_NONE }, { "?", OP_QUESTION, OP_NONE },
+    { ":", OP_COLON, OP_NONE }, { ",", OP_COMMA, OP_NONE },
+    { "(", OP_LPAREN, OP_NONE }, { ")", OP_RPAREN, OP_NONE },
+    { NULL, OP_NONE, OP_NONE }
+};
+
+static bool applyOperator(enum Operator op, intmax_t left, intmax_t right,
+        intmax_t* result);
+static void assignValue(const char* name, intmax_t value);
+static bool evaluate(const struct Arithmetic* node, intmax_t* result);
+static bool getValue(const char* name, intmax_t* result);
+static struct Arithmetic* newNode(struct Parser* parser, enum NodeType type,
+        enum Operator op);
+static void nextToken(struct Parser* parser);
+static struct Arithmetic* parseAssignment(struct Parser* parser);
+static struct Arithmetic* parseBinary(struct Parser* parser,
+        int minPrecedence);
+static struct Arithmetic* parseComma(struct Parser* parser);
+static struct Arithmetic* parseConditional(struct Parser* parser);
+static bool parseNumber(const char** s, intmax_t* result);
+static struct Arithmetic* parseUnary(struct Parser* parser);
+static int precedence(enum Operator op);
+static struct Arithmetic* syntaxError(struct Parser* parser);
+
+bool evaluateArithmetic(const struct Arithmetic* expression,
+        intmax_t* result) {
+    return evaluate(expression, result);
+}
+
+// Calls the callback for each variable that the expression assigns to.
+void findArithmeticAssignments(const struct Arithmetic* expression,
+        void (*callback)(const char* name, void* context), void* context) {
+    if (expression->type == NODE_ASSIGN ||
+            expression->type == NODE_INCREMENT) {
+        callback(expression->name, context);
+    }
+    for (size_t i = 0; i < 3; i++) {
+        if (expression->operands[i]) {
+            findArithmeticAssignments(expression->operands[i], callback,
+                    context);
+        }
+    }
+}
+
+// Parses an expression whose substitutions have already been expanded. The
+// result is allocated in the arena and can be evaluated repeatedly. Returns
+// NULL on syntax errors, which are reported unless quiet is set.
+struct Arithmetic* parseArithmetic(struct Arena* arena, const char* text,
+        bool quiet) {
+    struct Parser parser;
+    parser.arena = arena;
+    parser.text = text;
+    parser.next = text;
+    parser.quiet = quiet;
+    parser.token = OP_NONE;
+    nextToken(&parser);
+
+    if (parser.token == OP_END) {
+        // An empty expression evaluates to zero.
+        return newNode(&parser, NODE_NUMBER, OP_NONE);
+    }
+
+    struct Arithmetic* expression = parseComma(&parser);
+    if (expression && parser.token != OP_END) {
+        return syntaxError(&parser);
+    }
+    return expression;
+}
+
+static bool applyOperator(enum Operator op, intmax_t left, intmax_t right,
+        intmax_t* result) {
+    // Overflow wraps around instead of being undefined.
+    uintmax_t a = left;
+    uintmax_t b = right;
+    unsigned int shift = right & (sizeof(intmax_t) * CHAR_BIT - 1);
+
+    switch (op) {
+    case OP_COMMA: *result = right; break;
+    case OP_BITOR: *result = left | right; break;
+    case OP_XOR: *result = left ^ right; break;
+    case OP_BITAND: *result = left & right; break;
+    case OP_EQ: *result = left == right; break;
+    case OP_NE: *result = left != right; break;
+    case OP_LT: *result = left < right; break;
+    case OP_LE: *result = left <= right; break;
+    case OP_GT: *result = left > right; break;
+    case OP_GE: *result = left >= right; break;
+    case OP_SHL: *result = (intmax_t) (a << shift); break;
+    case OP_SHR: *result = left >> shift; break;
+    case OP_ADD: *result = (intmax_t) (a + b); break;
+    case OP_SUB: *result = (intmax_t) (a - b); break;
+    case OP_MUL: *result = (intmax_t) (a * b); break;
+    case OP_DIV:
+    case OP_MOD:
+        if (right == 0) {
+            warnx("division by zero");
+            return false;
+        }
+        if (left == INTMAX_MIN && right == -1) {
+            *result = op == OP_DIV ? INTMAX_MIN : 0;
+        } else {
+            *result = op == OP_DIV ? left / right : left % right;
+        }
+        break;
+    default:
+        *result = 0;
+    }
+    return true;
+}
+
+static void assignValue(const char* name, intmax_t value) {
+    char buffer[sizeof(intmax_t) * 3 + 2];
+    snprintf(buffer, sizeof(buffer), "%" PRIdMAX, value);
+    setVariable(name, buffer, false);
+}
+
+static bool evaluate(const struct Arithmetic* node, intmax_t* result) {
+    intmax_t left;
+    intmax_t right;
+
+    switch (node->type) {
+    case NODE_NUMBER:
+        *result = node->value;
+        return true;
+    case NODE_VARIABLE:
+        return getValue(node->name, result);
+    case NODE_UNARY:
+        if (!evaluate(node->operands[0], &left)) return false;
+        if (node->op == OP_SUB) {
+            *result = (intmax_t) -(uintmax_t) left;
+        } else if (node->op == OP_NOT) {
+            *result = !left;
+        } else if (node->op == OP_COMPLEMENT) {
+            *result = ~left;
+        } else {
+            *result = left;
+        }
+        return true;
+    case NODE_BINARY:
+        if (!evaluate(node->operands[0], &left)) return false;
+        if (node->op == OP_AND || node->op == OP_OR) {
+            // The right operand is only evaluated when it is needed.
+            if ((left != 0) == (node->op == OP_OR)) {
+                *result = left != 0;
+                return true;
+            }
+            if (!evaluate(node->operands[1], &right)) return false;
+            *result = right != 0;
+            return true;
+        }
+        if (!evaluate(node->operands[1], &right)) return false;
+        return applyOperator(node->op, left, right, result);
+    case NODE_CONDITIONAL:
+        if (!evaluate(node->operands[0], &left)) return false;
+        return evaluate(node->operands[left ? 1 : 2], result);
+    case NODE_ASSIGN:
+        if (!evaluate(node->operands[0], &right)) return false;
+        if (node->op != OP_NONE) {
+            if (!getValue(node->name, &left)) return false;
+            if (!applyOperator(node->op, left, right, &right)) return false;
+        }
+        assignValue(node->name, right);
+        *result = right;
+        return true;
+    case NODE_INCREMENT:
+        if (!getValue(node->name, &left)) return false;
+        applyOperator(node->op, left, 1, &right);
+        assignValue(node->name, right);
+        *result = node->postfix ? left : right;
+        return true;
+    }
+    return false;
+}
+
+// Variables that are unset or null have the value zero. Otherwise their value
+// must be an integer constant.
+static bool getValue(const char* name, intmax_t* result) {
+    const char* value = getVariable(name);
+    *result = 0;
+    if (!value || !*value) return true;
+
+    const char* s = value;
+    while (isspace((unsigned char) *s)) s++;
+    bool negative = *s == '-';
+    if (*s == '-' || *s == '+') s++;
+    bool valid = isdigit((unsigned char) *s) && parseNumber(&s, result);
+    while (isspace((unsigned char) *s)) s++;
+
+    if (!valid || *s) {
+        warnx("%s: invalid number '%s'", name, value);
+        return false;
+    }
+    if (negative) {
+        *result = (intmax_t) -(uintmax_t) *result;
+    }
+    return true;
+}
+
+static struct Arithmetic* newNode(struct Parser* parser, enum NodeType type,
+        enum Operator op) {
+    struct Arithmetic* node = arenaAllocate(parser->arena,
+            sizeof(struct Arithmetic));
+    node->type = type;
+    node->op = op;
+    node->postfix = false;
+    node->value = 0;
+    node->name = NULL;
+    node->operands[0] = NULL;
+    node->operands[1] = NULL;
+    node->operands[2] = NULL;
+    return node;
+}
+
+static void nextToken(struct Parser* parser) {
+    // Increments and decrements must be adjacent to a variable name.
+    // Otherwise ++ and -- are two unary or binary operators.
+    bool afterName = parser->token == OP_NAME;
+
+    const char* s = parser->next;
+    while (isspace((unsigned char) *s)) s++;
+    parser->assignOp = OP_NONE;
+
+    if (!*s) {
+        parser->token = OP_END;
+    } else if (isdigit((unsigned char) *s)) {
+        parser->token = parseNumber(&s, &parser->value) ? OP_NUMBER :
+                OP_INVALID;
+    } else if (isalpha((unsigned char) *s) || *s == '_') {
+        parser->token = OP_NAME;
+        parser->name = s;
+        while (isalnum((unsigned char) *s) || *s == '_') s++;
+        parser->nameLength = s - parser->name;
+    } else {
+        parser->token = OP_INVALID;
+        for (size_t i = 0; operators[i].text; i++) {
+            size_t length = strlen(operators[i].text);
+            if (strncmp(s, operators[i].text, length) != 0) continue;
+
+            if ((operators[i].token == OP_INCREMENT ||
+                    operators[i].token == OP_DECREMENT) && !afterName) {
+                const char* t = s + length;
+                while (isspace((unsigned char) *t)) t++;
+                if (!isalpha((unsigned char) *t) && *t != '_') continue;
+            }
+
+            parser->token = operators[i].token;
+            parser->assignOp = operators[i].assignOp;
+            s += length;
+            break;
+        }
+    }
+    parser->next = s;
+}
+
+static struct Arithmetic* parseAssignment(struct Parser* parser) {
+    struct Arithmetic* left = parseConditional(parser);
+    if (!left || parser->token != OP_ASSIGN) return left;
+    if (left->type != NODE_VARIABLE) return syntaxError(parser);
+
+    enum Operator op = parser->assignOp;
+    nextToken(parser);
+    struct Arithmetic* right = parseAssignment(parser);
+    if (!right) return NULL;
+
+    struct Arithmetic* node = newNode(parser, NODE_ASSIGN, op);
+    node->name = left->name;
+    node->operands[0] = right;
+    return node;
+}
+
+static struct Arithmetic* parseBinary(struct Parser* parser,
+        int minPrecedence) {
+    struct Arithmetic* left = parseUnary(parser);
+    while (left) {
+        enum Operator op = parser->token;
+        int prec = precedence(op);
+        if (prec == 0 || prec < minPrecedence) break;
+
+        nextToken(parser);
+        struct Arithmetic* right = parseBinary(parser, prec + 1);
+        if (!right) return NULL;
+
+        struct Arithmetic* node = newNode(parser, NODE_BINARY, op);
+        node->operands[0] = left;
+        node->operands[1] = right;
+        left = node;
+    }
+    return left;
+}
+
+static struct Arithmetic* parseComma(struct Parser* parser) {
+    struct Arithmetic* left = parseAssignment(parser);
+    while (left && parser->token == OP_COMMA) {
+        nextToken(parser);
+        struct Arithmetic* right = parseAssignment(parser);
+        if (!right) return NULL;
+
+        struct Arithmetic* node = newNode(parser, NODE_BINARY, OP_COMMA);
+        node->operands[0] = left;
+        node->operands[1] = right;
+        left = node;
+    }
+    return left;
+}
+
+static struct Arithmetic* parseConditional(struct Parser* parser) {
+    struct Arithmetic* condition = parseBinary(parser, 1);
+    if (!condition || parser->token != OP_QUESTION) return condition;
+
+    nextToken(parser);
+    struct Arithmetic* then = parseComma(parser);
+    if (!then) return NULL;
+    if (parser->token != OP_COLON) return syntaxError(parser);
+
+    nextToken(parser);
+    struct Arithmetic* otherwise = parseConditional(parser);
+    if (!otherwise) return NULL;
+
+    struct Arithmetic* node = newNode(parser, NODE_CONDITIONAL, OP_NONE);
+    node->operands[0] = condition;
+    node->operands[1] = then;
+    node->operands[2] = otherwise;
+    return node;
+}
+
+// Parses a decimal, octal or hexadecimal constant.
+static bool parseNumber(const char** s, intmax_t* result) {
+    const char* p = *s;
+    unsigned int base = 10;
+    if (p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+        base = 16;
+        p += 2;
+        if (!isxdigit((unsigned char) *p)) return false;
+    } else if (p[0] == '0') {
+        base = 8;
+    }
+
+    uintmax_t value = 0;
+    while (isalnum((unsigned char) *p) || *p == '_') {
+        unsigned int digit;
+        if (isdigit((unsigned char) *p)) {
+            digit = *p - '0';
+        } else if (isxdigit((unsigned char) *p)) {
+            digit = tolower((unsigned char) *p) - 'a' + 10;
+        } else {
+            return false;
+        }
+        if (digit >= base) return false;
+        value = value * base + digit;
+        p++;
+    }
+
+    *result = (intmax_t) value;
+    *s = p;
+    return true;
+}
+
+static struct Arithmetic* parseUnary(struct Parser* parser) {
+    enum Operator op = parser->token;
+    struct Arithmetic* node;
+
+    if (op == OP_ADD || op == OP_SUB || op == OP_NOT || op == OP_COMPLEMENT) {
+        nextToken(parser);
+        struct Arithmetic* operand = parseUnary(parser);
+        if (!operand) return NULL;
+        node = newNode(parser, NODE_UNARY, op);
+        node->operands[0] = operand;
+        return node;
+    } else if (op == OP_INCREMENT || op == OP_DECREMENT) {
+        nextToken(parser);
+        if (parser->token != OP_NAME) return syntaxError(parser);
+        node = newNode(parser, NODE_INCREMENT,
+                op == OP_INCREMENT ? OP_ADD : OP_SUB);
+        node->name = arenaStrndup(parser->arena, parser->name,
+                parser->nameLength);
+        nextToken(parser);
+        return node;
+    } else if (op == OP_NUMBER) {
+        node = newNode(parser, NODE_NUMBER, OP_NONE);
+        node->value = parser->value;
+        nextToken(parser);
+        return node;
+    } else if (op == OP_NAME) {
+        node = newNode(parser, NODE_VARIABLE, OP_NONE);
+        node->name = arenaStrndup(parser->arena, parser->name,
+                parser->nameLength);
+        nextToken(parser);
+        if (parser->token == OP_INCREMENT || parser->token == OP_DECREMENT) {
+            node->type = NODE_INCREMENT;
+            node->op = parser->token == OP_INCREMENT ? OP_ADD : OP_SUB;
+            node->postfix = true;
+            nextToken(parser);
+        }
+        return node;
+    } else if (op == OP_LPAREN) {
+        nextToken(parser);
+        node = parseComma(parser);
+        if (!node) return NULL;
+        if (parser->token != OP_RPAREN) return syntaxError(parser);
+        nextToken(parser);
+        return node;
+    }
+
+    return syntaxError(parser);
+}
+
+static int precedence(enum Operator op) {
+    switch (op) {
+    case OP_OR: return 1;
+    case OP_AND: return 2;
+    case OP_BITOR: return 3;
+    case OP_XOR: return 4;
+    case OP_BITAND: return 5;
+    case OP_EQ: case OP_NE: return 6;
+    case OP_LT: case OP_LE: case OP_GT: case OP_GE: return 7;
+    case OP_SHL: case OP_SHR: return 8;
+    case OP_ADD: case OP_SUB: return 9;
+    case OP_MUL: case OP_DIV: case OP_MOD: return 10;
+    default: return 0;
+    }
+}
+
+static struct Arithmetic* syntaxError(struct Parser* parser) {
+    if (!parser->quiet) {
+        warnx("syntax error in arithmetic expression '%s'", parser->text);
+    }
+    return NULL;
+}
@@ -0,0 +1,36 @@
+/* Copyright (c) 2026 Dennis Wölfing
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* arith.h
+ * Arithmetic expansion.
+ */
+
+#ifndef ARITH_H
+#define ARITH_H
+
+#include <stdint.h>
+#include "arena.h"
+#include "dxsh.h"
+
+struct Arithmetic;
+
+NO_DISCARD bool evaluateArithmetic(const struct Arithmetic* expression,
+        intmax_t* result);
+void findArithmeticAssignments(const struct Arithmetic* expression,
+        void (*callback)(const char* name, void* context), void* context);
+struct Arithmetic* parseArithmetic(struct Arena* arena, const char* text,
+        bool quiet);
+
+#endif
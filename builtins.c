@@ -1,4 +1,4 @@
-/* Copyright (c) 2018, 2019, 2020, 2021, 2022, 2023, 2025 Dennis Wölfing
+/* Copyright (c) 2018, 2019, 2020, 2021, 2022, 2023, 2025, 2026 Dennis Wölfing
  *
  * Permission to use, copy, modify, and/or distribute this software for any
  * purpose with or without fee is hereby granted, provided that the above
@@ -31,6 +31,7 @@ const struct builtin builtins[] = {
     { "command", command, 0 },
     { "continue", sh_continue, BUILTIN_SPECIAL },
     { ".", dot, BUILTIN_SPECIAL },
+    { "dxcache", dxcache, 0 },
     { "eval", eval, BUILTIN_SPECIAL },
     { "exec", exec, BUILTIN_SPECIAL },
     { "exit", sh_exit, BUILTIN_SPECIAL },
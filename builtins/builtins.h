@@ -1,4 +1,4 @@
-/* Copyright (c) 2025 Dennis Wölfing
+/* Copyright (c) 2025, 2026 Dennis Wölfing
  *
  * Permission to use, copy, modify, and/or distribute this software for any
  * purpose with or without fee is hereby granted, provided that the above
@@ -26,6 +26,7 @@ int colon(int argc, char* argv[]);
 int command(int argc, char* argv[]);
 int sh_continue(int argc, char* argv[]);
 int dot(int argc, char* argv[]);
+int dxcache(int argc, char* argv[]);
 int eval(int argc, char* argv[]);
 int exec(int argc, char* argv[]);
 int sh_exit(int argc, char* argv[]);
@@ -1,4 +1,4 @@
-/* Copyright (c) 2022, 2025 Dennis Wölfing
+/* Copyright (c) 2022, 2025, 2026 Dennis Wölfing
  *
  * Permission to use, copy, modify, and/or distribute this software for any
  * purpose with or without fee is hereby granted, provided that the above
@@ -20,11 +20,14 @@
 #include <config.h>
 #include <err.h>
 #include <errno.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 
 #include "builtins.h"
+#include "../cache.h"
 #include "../dxsh.h"
 #include "../execute.h"
 
@@ -34,18 +37,19 @@ struct DotContext {
     size_t bufferSize;
 };
 
-static bool readInputFromFile(const char** str, bool newCommand,
-        void* context) {
+static bool readInputFromFile(const char** str, size_t* length,
+        bool newCommand, void* context) {
     (void) newCommand;
     struct DotContext* ctx = context;
     FILE* file = ctx->file;
 
-    ssize_t length = getline(&ctx->buffer, &ctx->bufferSize, file);
+    ssize_t bytesRead = getline(&ctx->buffer, &ctx->bufferSize, file);
 
-    if (length < 0 && !feof(file)) err(1, "getline");
-    if (length < 0) return false;
+    if (bytesRead < 0 && !feof(file)) err(1, "getline");
+    if (bytesRead < 0) return false;
 
     *str = ctx->buffer;
+    *length = bytesRead;
     return true;
 }
 
@@ -80,6 +84,8 @@ int dot(int argc, char* argv[]) {
         }
     }
 
+    // The file might be the shell's own input.
+    syncInput();
     FILE* file = fopen(pathname, "r");
     if (!file) {
         warn(".: '%s'", pathname);
@@ -92,25 +98,39 @@ int dot(int argc, char* argv[]) {
         free(pathname);
     }
 
-    struct DotContext context;
-    context.file = file;
-    context.buffer = NULL;
-    context.bufferSize = 0;
-
-    struct Parser parser;
-    initParser(&parser, readInputFromFile, &context);
-    struct CompleteCommand command;
-    enum ParserResult parserResult = parse(&parser, &command, true);
-    freeParser(&parser);
-    free(context.buffer);
-    fclose(file);
+    // Files that have not changed since they were last sourced do not need to
+    // be parsed again.
+    struct stat st;
+    if (fstat(fileno(file), &st) < 0) err(1, "fstat");
+    uintmax_t key[] = { st.st_dev, st.st_ino, st.st_size, st.st_mtim.tv_sec,
+            st.st_mtim.tv_nsec };
+
+    struct CompleteCommand* command = checkOutCommand(&dotCache, key,
+            sizeof(key));
+    if (!command) {
+        command = malloc(sizeof(struct CompleteCommand));
+        if (!command) err(1, "malloc");
+
+        struct DotContext context;
+        context.file = file;
+        context.buffer = NULL;
+        context.bufferSize = 0;
+
+        struct Parser parser;
+        initParser(&parser, readInputFromFile, &context);
+        enum ParserResult parserResult = parse(&parser, command, true);
+        freeParser(&parser);
+        free(context.buffer);
 
-    int status = 1;
-    if (parserResult == PARSER_MATCH) {
-        status = execute(&command);
-        freeCompleteCommand(&command);
-    } else if (parserResult == PARSER_NO_CMD) {
-        status = 0;
+        if (parserResult != PARSER_MATCH) {
+            free(command);
+            fclose(file);
+            return parserResult == PARSER_NO_CMD ? 0 : 1;
+        }
     }
+    fclose(file);
+
+    int status = execute(command, false);
+    checkInCommand(&dotCache, key, sizeof(key), command);
     return status;
 }
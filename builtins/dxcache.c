@@ -0,0 +1,89 @@
+/* Copyright (c) 2026 Dennis Wölfing
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* builtins/dxcache.c
+ * Show statistics about parsed command caches and change their sizes.
+ */
+
+#include <config.h>
+#include <err.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "builtins.h"
+#include "../cache.h"
+#include "../match.h"
+
+static int setCacheSize(const char* name, const char* size) {
+    struct Cache* cache = NULL;
+    for (size_t i = 0; caches[i]; i++) {
+        if (strcmp(caches[i]->name, name) == 0) {
+            cache = caches[i];
+        }
+    }
+    bool glob = strcmp(name, "glob") == 0;
+    if (!cache && !glob) {
+        warnx("dxcache: unknown cache '%s'", name);
+        return 1;
+    }
+
+    char* end;
+    errno = 0;
+    unsigned long maxEntries = strtoul(size, &end, 10);
+    if (errno || *end || !*size || *size == '-' || maxEntries > SIZE_MAX) {
+        warnx("dxcache: invalid number '%s'", size);
+        return 1;
+    }
+
+    if (glob) {
+        resizeDirectoryCache(maxEntries);
+    } else {
+        resizeCache(cache, maxEntries);
+    }
+    return 0;
+}
+
+int dxcache(int argc, char* argv[]) {
+    if (argc > 1 && strcmp(argv[1], "-s") == 0) {
+        if (argc < 4) {
+            warnx("dxcache: missing operand");
+            return 1;
+        } else if (argc > 4) {
+            warnx("dxcache: too many arguments");
+            return 1;
+        }
+        return setCacheSize(argv[2], argv[3]);
+    }
+
+    if (argc > 1) {
+        warnx("dxcache: too many arguments");
+        return 1;
+    }
+
+    for (size_t i = 0; caches[i]; i++) {
+        printf("%s: %lu hits, %lu misses, %lu evictions, %zu/%zu entries\n",
+                caches[i]->name, caches[i]->hits, caches[i]->misses,
+                caches[i]->evictions, caches[i]->numEntries,
+                caches[i]->maxEntries);
+    }
+    printf("glob: %lu hits, %lu misses, %lu evictions, %zu/%zu entries, "
+            "%zu names\n", directoryCache.hits, directoryCache.misses,
+            directoryCache.evictions, directoryCache.numEntries,
+            directoryCache.maxEntries, directoryCache.numNames);
+    return 0;
+}
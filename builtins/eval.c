@@ -1,4 +1,4 @@
-/* Copyright (c) 2022, 2025 Dennis Wölfing
+/* Copyright (c) 2022, 2025, 2026 Dennis Wölfing
  *
  * Permission to use, copy, modify, and/or distribute this software for any
  * purpose with or without fee is hereby granted, provided that the above
@@ -18,20 +18,24 @@
  */
 
 #include <config.h>
+#include <err.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "builtins.h"
+#include "../cache.h"
 #include "../dxsh.h"
 #include "../execute.h"
 #include "../stringbuffer.h"
 
-static bool readInputFromString(const char** str, bool newCommand,
-        void* context) {
+static bool readInputFromString(const char** str, size_t* length,
+        bool newCommand, void* context) {
     (void) newCommand;
 
     const char** word = context;
     if (!*word) return false;
     *str = *word;
+    *length = strlen(*word);
     *word = NULL;
     return true;
 }
@@ -48,23 +52,32 @@ int eval(int argc, char* argv[]) {
     }
     appendToStringBuffer(&buffer, '\n');
 
+    size_t length = buffer.used;
     char* string = finishStringBuffer(&buffer);
-    struct Parser parser;
-    const char* context = string;
-    initParser(&parser, readInputFromString, &context);
 
-    struct CompleteCommand command;
-    enum ParserResult parserResult = parse(&parser, &command, true);
+    // Scripts often evaluate the same strings repeatedly, so parsed commands
+    // are cached.
+    struct CompleteCommand* command = checkOutCommand(&evalCache, string,
+            length);
+    if (!command) {
+        command = malloc(sizeof(struct CompleteCommand));
+        if (!command) err(1, "malloc");
 
-    int status = 0;
-    if (parserResult == PARSER_MATCH) {
-        status = execute(&command);
-        freeCompleteCommand(&command);
-    } else if (parserResult == PARSER_SYNTAX) {
-        status = 1;
+        struct Parser parser;
+        const char* context = string;
+        initParser(&parser, readInputFromString, &context);
+        enum ParserResult parserResult = parse(&parser, command, true);
+        freeParser(&parser);
+
+        if (parserResult != PARSER_MATCH) {
+            free(command);
+            free(string);
+            return parserResult == PARSER_SYNTAX ? 1 : 0;
+        }
     }
 
-    freeParser(&parser);
+    int status = execute(command, false);
+    checkInCommand(&evalCache, string, length, command);
     free(string);
     return status;
 }
@@ -1,4 +1,4 @@
-/* Copyright (c) 2023, 2025 Dennis Wölfing
+/* Copyright (c) 2023, 2025, 2026 Dennis Wölfing
  *
  * Permission to use, copy, modify, and/or distribute this software for any
  * purpose with or without fee is hereby granted, provided that the above
@@ -24,6 +24,7 @@
 #include <unistd.h>
 
 #include "builtins.h"
+#include "../dxsh.h"
 #include "../stringbuffer.h"
 #include "../variables.h"
 
@@ -81,6 +82,7 @@ int sh_read(int argc, char* argv[]) {
         ifs = " \t\n";
     }
 
+    syncInput();
     bool delimiterFound = false;
     bool ignoreIfsAtBegin = false;
     bool eofReached = false;
@@ -99,7 +101,7 @@ int sh_read(int argc, char* argv[]) {
 
             if (bytesRead < 0) {
                 warn("read: read error");
-                free(finishStringBuffer(&buffer));
+                freeStringBuffer(&buffer);
                 return 2;
             } else if (bytesRead == 0) {
                 eofReached = true;
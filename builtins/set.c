@@ -1,4 +1,4 @@
-/* Copyright (c) 2022, 2025 Dennis Wölfing
+/* Copyright (c) 2022, 2025, 2026 Dennis Wölfing
  *
  * Permission to use, copy, modify, and/or distribute this software for any
  * purpose with or without fee is hereby granted, provided that the above
@@ -39,6 +39,8 @@ static void printOptionStatus(bool plusOption, const char* optionName,
 static void printOptions(bool plusOption) {
     printOptionStatus(plusOption, "allexport", shellOptions.allexport);
     printOptionStatus(plusOption, "errexit", shellOptions.errexit);
+    printOptionStatus(plusOption, "globcache", shellOptions.globcache);
+    printOptionStatus(plusOption, "globstar", shellOptions.globstar);
     printOptionStatus(plusOption, "hashall", shellOptions.hashall);
     printOptionStatus(plusOption, "ignoreeof", shellOptions.ignoreeof);
     printOptionStatus(plusOption, "monitor", shellOptions.monitor);
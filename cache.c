@@ -0,0 +1,169 @@
+/* Copyright (c) 2026 Dennis Wölfing
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* cache.c
+ * Caches for parsed commands.
+ */
+
+#include <config.h>
+#include <err.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cache.h"
+#include "dxsh.h"
+
+struct Cache dotCache = { .name = "dot", .maxEntries = 32 };
+struct Cache evalCache = { .name = "eval", .maxEntries = 64 };
+
+struct Cache* const caches[] = { &dotCache, &evalCache, NULL };
+
+static struct CacheEntry* findEntry(struct Cache* cache, const void* key,
+        size_t keyLength, size_t hash);
+static struct CacheEntry* findLeastRecentlyUsed(struct Cache* cache);
+static size_t hashKey(const void* key, size_t keyLength);
+static void removeEntry(struct Cache* cache, struct CacheEntry* entry);
+
+// Commands that are currently being executed are checked out of the cache so
+// that recursive invocations do not execute the same command concurrently.
+// While checked out the command is owned by the currentCommand chain.
+struct CompleteCommand* checkOutCommand(struct Cache* cache, const void* key,
+        size_t keyLength) {
+    struct CacheEntry* entry = findEntry(cache, key, keyLength,
+            hashKey(key, keyLength));
+    if (!entry || entry->inUse) {
+        cache->misses++;
+        return NULL;
+    }
+
+    cache->hits++;
+    entry->inUse = true;
+    entry->lastUse = ++cache->useCounter;
+    return entry->command;
+}
+
+void checkInCommand(struct Cache* cache, const void* key, size_t keyLength,
+        struct CompleteCommand* command) {
+    size_t hash = hashKey(key, keyLength);
+    struct CacheEntry* entry = findEntry(cache, key, keyLength, hash);
+    if (entry) {
+        if (entry->command == command) {
+            entry->inUse = false;
+            if (cache->numEntries > cache->maxEntries) {
+                // The cache was shrunk while the command was in use.
+                resizeCache(cache, cache->maxEntries);
+            }
+        } else {
+            // The entry was in use when the command was parsed.
+            freeCompleteCommand(command);
+            free(command);
+        }
+        return;
+    }
+
+    if (cache->numEntries >= cache->maxEntries) {
+        struct CacheEntry* leastRecentlyUsed = findLeastRecentlyUsed(cache);
+        if (!leastRecentlyUsed) {
+            freeCompleteCommand(command);
+            free(command);
+            return;
+        }
+        removeEntry(cache, leastRecentlyUsed);
+        cache->evictions++;
+    }
+
+    struct CacheEntry newEntry;
+    newEntry.key = malloc(keyLength);
+    if (!newEntry.key) err(1, "malloc");
+    memcpy(newEntry.key, key, keyLength);
+    newEntry.keyLength = keyLength;
+    newEntry.hash = hash;
+    newEntry.command = command;
+    newEntry.lastUse = ++cache->useCounter;
+    newEntry.inUse = false;
+    addToArray((void**) &cache->entries, &cache->numEntries, &newEntry,
+            sizeof(newEntry));
+}
+
+void clearCaches(void) {
+    // Commands that are checked out have already been freed as part of the
+    // currentCommand chain.
+    for (size_t i = 0; caches[i]; i++) {
+        struct Cache* cache = caches[i];
+        for (size_t j = 0; j < cache->numEntries; j++) {
+            if (!cache->entries[j].inUse) {
+                freeCompleteCommand(cache->entries[j].command);
+            }
+            free(cache->entries[j].command);
+            free(cache->entries[j].key);
+        }
+        free(cache->entries);
+        cache->entries = NULL;
+        cache->numEntries = 0;
+    }
+}
+
+void resizeCache(struct Cache* cache, size_t maxEntries) {
+    cache->maxEntries = maxEntries;
+    // Entries that are in use are removed when they are checked in.
+    while (cache->numEntries > maxEntries) {
+        struct CacheEntry* leastRecentlyUsed = findLeastRecentlyUsed(cache);
+        if (!leastRecentlyUsed) break;
+        removeEntry(cache, leastRecentlyUsed);
+        cache->evictions++;
+    }
+}
+
+static struct CacheEntry* findEntry(struct Cache* cache, const void* key,
+        size_t keyLength, size_t hash) {
+    for (size_t i = 0; i < cache->numEntries; i++) {
+        struct CacheEntry* entry = &cache->entries[i];
+        if (entry->hash == hash && entry->keyLength == keyLength &&
+                memcmp(entry->key, key, keyLength) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static struct CacheEntry* findLeastRecentlyUsed(struct Cache* cache) {
+    struct CacheEntry* leastRecentlyUsed = NULL;
+    for (size_t i = 0; i < cache->numEntries; i++) {
+        if (cache->entries[i].inUse) continue;
+        if (!leastRecentlyUsed ||
+                cache->entries[i].lastUse < leastRecentlyUsed->lastUse) {
+            leastRecentlyUsed = &cache->entries[i];
+        }
+    }
+    return leastRecentlyUsed;
+}
+
+static size_t hashKey(const void* key, size_t keyLength) {
+    // FNV-1a
+    const unsigned char* bytes = key;
+    size_t hash = (size_t) 14695981039346656037ULL;
+    for (size_t i = 0; i < keyLength; i++) {
+        hash ^= bytes[i];
+        hash *= (size_t) 1099511628211ULL;
+    }
+    return hash;
+}
+
+static void removeEntry(struct Cache* cache, struct CacheEntry* entry) {
+    freeCompleteCommand(entry->command);
+    free(entry->command);
+    free(entry->key);
+    *entry = cache->entries[--cache->numEntries];
+}
@@ -0,0 +1,56 @@
+/* Copyright (c) 2026 Dennis Wölfing
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* cache.h
+ * Caches for parsed commands.
+ */
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "parser.h"
+
+struct CacheEntry {
+    void* key;
+    size_t keyLength;
+    size_t hash;
+    struct CompleteCommand* command;
+    unsigned long lastUse;
+    bool inUse;
+};
+
+struct Cache {
+    const char* name;
+    size_t maxEntries;
+    size_t numEntries;
+    struct CacheEntry* entries;
+    unsigned long useCounter;
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+};
+
+extern struct Cache dotCache;
+extern struct Cache evalCache;
+extern struct Cache* const caches[];
+
+struct CompleteCommand* checkOutCommand(struct Cache* cache, const void* key,
+        size_t keyLength);
+void checkInCommand(struct Cache* cache, const void* key, size_t keyLength,
+        struct CompleteCommand* command);
+void clearCaches(void);
+void resizeCache(struct Cache* cache, size_t maxEntries);
+
+#endif
@@ -0,0 +1,639 @@
+/* Copyright (c) 2026 Dennis Wölfing
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* compile.c
+ * Precompiled scripts.
+ */
+
+#include <config.h>
+#include <err.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "compile.h"
+#include "match.h"
+#include "stringbuffer.h"
+#include "word.h"
+
+// A compiled script consists of a header followed by the payload. All numbers
+// in the payload are encoded as unsigned LEB128. Strings are stored as their
+// length followed by the string contents including the terminating null byte
+// so that the loaded syntax tree can point directly into the mapped file.
+#define MAGIC "\177DXC"
+#define MAGIC_SIZE 4
+#define FORMAT_VERSION 1
+#define HEADER_SIZE 16
+#define MAX_NESTING 1000
+
+struct CompileContext {
+    FILE* file;
+    char* buffer;
+    size_t bufferSize;
+    bool endOfFile;
+};
+
+struct Reader {
+    struct Arena* arena;
+    const char* data;
+    size_t size;
+    size_t offset;
+    size_t nesting;
+    bool error;
+};
+
+static uint64_t checksum(const char* data, size_t size);
+static bool readBool(struct Reader* reader);
+static bool readCommand(struct Reader* reader, struct Command* command);
+static size_t readCount(struct Reader* reader);
+static bool readFunction(struct Reader* reader, struct Function** function);
+static bool readInputFromFile(const char** str, size_t* length,
+        bool newCommand, void* context);
+static bool readList(struct Reader* reader, struct List* list);
+static uintmax_t readNumber(struct Reader* reader, uintmax_t max);
+static bool readRedirections(struct Reader* reader,
+        struct Redirection** redirections, size_t* numRedirections);
+static char* readString(struct Reader* reader);
+static struct Word* readWord(struct Reader* reader, bool noQuotes);
+static bool readWords(struct Reader* reader, struct Word*** words,
+        size_t* numWords);
+static void* allocateArray(struct Reader* reader, size_t count, size_t size);
+static bool writeCommand(struct StringBuffer* sb, struct Command* command,
+        size_t nesting);
+static bool writeList(struct StringBuffer* sb, struct List* list,
+        size_t nesting);
+static void writeNumber(struct StringBuffer* sb, uintmax_t number);
+static void writeRedirections(struct StringBuffer* sb,
+        struct Redirection* redirections, size_t numRedirections);
+static void writeString(struct StringBuffer* sb, const char* string);
+static void writeWords(struct StringBuffer* sb, struct Word** words,
+        size_t numWords);
+
+bool compileScript(const char* inputPath, const char* outputPath) {
+    struct CompileContext context;
+    context.file = fopen(inputPath, "r");
+    if (!context.file) {
+        warn("'%s'", inputPath);
+        return false;
+    }
+    context.buffer = NULL;
+    context.bufferSize = 0;
+    context.endOfFile = false;
+
+    // Commands are parsed in the same way as when the script is executed
+    // directly.
+    struct StringBuffer commands;
+    initStringBuffer(&commands);
+    size_t numCommands = 0;
+    bool success = true;
+
+    while (!context.endOfFile) {
+        struct Parser parser;
+        initParser(&parser, readInputFromFile, &context);
+        struct CompleteCommand command;
+        enum ParserResult parserResult = parse(&parser, &command, false);
+        freeParser(&parser);
+
+        if (parserResult == PARSER_MATCH) {
+            success = writeList(&commands, &command.list, 0);
+            freeCompleteCommand(&command);
+            numCommands++;
+            if (!success) {
+                warnx("'%s': script is nested too deeply", inputPath);
+                break;
+            }
+        } else if (parserResult == PARSER_SYNTAX) {
+            success = false;
+            break;
+        }
+    }
+    free(context.buffer);
+    fclose(context.file);
+
+    if (!success) {
+        freeStringBuffer(&commands);
+        return false;
+    }
+
+    struct StringBuffer payload;
+    initStringBuffer(&payload);
+    writeNumber(&payload, numCommands);
+    appendBytesToStringBuffer(&payload, commands.buffer, commands.used);
+    freeStringBuffer(&commands);
+
+    unsigned char header[HEADER_SIZE];
+    memcpy(header, MAGIC, MAGIC_SIZE);
+    uint32_t version = FORMAT_VERSION;
+    for (size_t i = 0; i < 4; i++) {
+        header[MAGIC_SIZE + i] = version >> (8 * i);
+    }
+    uint64_t sum = checksum(payload.buffer, payload.used);
+    for (size_t i = 0; i < 8; i++) {
+        header[MAGIC_SIZE + 4 + i] = sum >> (8 * i);
+    }
+
+    FILE* output = fopen(outputPath, "w");
+    if (!output) {
+        warn("'%s'", outputPath);
+        freeStringBuffer(&payload);
+        return false;
+    }
+
+    if (fwrite(header, 1, HEADER_SIZE, output) != HEADER_SIZE ||
+            fwrite(payload.buffer, 1, payload.used, output) != payload.used) {
+        success = false;
+    }
+    if (fclose(output) != 0) {
+        success = false;
+    }
+    freeStringBuffer(&payload);
+
+    if (!success) {
+        warn("'%s'", outputPath);
+        unlink(outputPath);
+    }
+    return success;
+}
+
+bool isCompiledScript(int fd) {
+    char magic[MAGIC_SIZE];
+    return pread(fd, magic, MAGIC_SIZE, 0) == MAGIC_SIZE &&
+            memcmp(magic, MAGIC, MAGIC_SIZE) == 0;
+}
+
+struct CompiledScript* loadCompiledScript(int fd, const char* pathname) {
+    struct stat st;
+    if (fstat(fd, &st) < 0) err(1, "fstat");
+    if (!S_ISREG(st.st_mode) || st.st_size < HEADER_SIZE ||
+            (uintmax_t) st.st_size > SIZE_MAX) {
+        errx(1, "'%s': invalid compiled script", pathname);
+    }
+
+    size_t size = st.st_size;
+    void* mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED) err(1, "mmap");
+    const unsigned char* header = mapping;
+
+    uint32_t version = 0;
+    for (size_t i = 0; i < 4; i++) {
+        version |= (uint32_t) header[MAGIC_SIZE + i] << (8 * i);
+    }
+    if (version != FORMAT_VERSION) {
+        errx(1, "'%s': unsupported compiled script version %" PRIu32,
+                pathname, version);
+    }
+
+    uint64_t sum = 0;
+    for (size_t i = 0; i < 8; i++) {
+        sum |= (uint64_t) header[MAGIC_SIZE + 4 + i] << (8 * i);
+    }
+
+    struct CompiledScript* script = malloc(sizeof(struct CompiledScript));
+    if (!script) err(1, "malloc");
+    initArena(&script->arena);
+
+    struct Reader reader;
+    reader.arena = &script->arena;
+    reader.data = (const char*) mapping + HEADER_SIZE;
+    reader.size = size - HEADER_SIZE;
+    reader.offset = 0;
+    reader.nesting = 0;
+    reader.error = false;
+
+    if (checksum(reader.data, reader.size) != sum) {
+        errx(1, "'%s': compiled script is corrupted", pathname);
+    }
+
+    script->mapping = mapping;
+    script->size = size;
+    script->nextCommand = 0;
+    script->numCommands = readCount(&reader);
+    script->commands = allocateArray(&reader, script->numCommands,
+            sizeof(struct CompleteCommand));
+
+    for (size_t i = 0; i < script->numCommands && !reader.error; i++) {
+        script->commands[i].prevCommand = NULL;
+        initArena(&script->commands[i].arena);
+        readList(&reader, &script->commands[i].list);
+    }
+
+    if (reader.error || reader.offset != reader.size) {
+        errx(1, "'%s': invalid compiled script", pathname);
+    }
+    return script;
+}
+
+struct CompleteCommand* nextCompiledCommand(struct CompiledScript* script) {
+    if (script->nextCommand >= script->numCommands) return NULL;
+    return &script->commands[script->nextCommand++];
+}
+
+static uint64_t checksum(const char* data, size_t size) {
+    // FNV-1a
+    uint64_t hash = UINT64_C(14695981039346656037);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= (unsigned char) data[i];
+        hash *= UINT64_C(1099511628211);
+    }
+    return hash;
+}
+
+static bool readInputFromFile(const char** str, size_t* length,
+        bool newCommand, void* context) {
+    (void) newCommand;
+    struct CompileContext* ctx = context;
+
+    ssize_t bytesRead = getline(&ctx->buffer, &ctx->bufferSize, ctx->file);
+    if (bytesRead < 0 && !feof(ctx->file)) err(1, "getline");
+    if (bytesRead < 0) {
+        ctx->endOfFile = true;
+        return false;
+    }
+
+    *str = ctx->buffer;
+    *length = bytesRead;
+    return true;
+}
+
+static void writeNumber(struct StringBuffer* sb, uintmax_t number) {
+    do {
+        unsigned char byte = number & 0x7F;
+        number >>= 7;
+        if (number) {
+            byte |= 0x80;
+        }
+        appendToStringBuffer(sb, byte);
+    } while (number);
+}
+
+static void writeString(struct StringBuffer* sb, const char* string) {
+    size_t length = strlen(string);
+    writeNumber(sb, length);
+    appendBytesToStringBuffer(sb, string, length + 1);
+}
+
+static void writeWords(struct StringBuffer* sb, struct Word** words,
+        size_t numWords) {
+    writeNumber(sb, numWords);
+    for (size_t i = 0; i < numWords; i++) {
+        writeString(sb, words[i]->text);
+    }
+}
+
+static void writeRedirections(struct StringBuffer* sb,
+        struct Redirection* redirections, size_t numRedirections) {
+    writeNumber(sb, numRedirections);
+    for (size_t i = 0; i < numRedirections; i++) {
+        writeNumber(sb, redirections[i].fd);
+        writeNumber(sb, redirections[i].type);
+        if (redirections[i].type == REDIR_HERE_DOC_QUOTED) {
+            writeString(sb, redirections[i].filename);
+        } else {
+            writeString(sb, redirections[i].word->text);
+        }
+    }
+}
+
+static bool writeList(struct StringBuffer* sb, struct List* list,
+        size_t nesting) {
+    if (++nesting > MAX_NESTING) return false;
+
+    writeNumber(sb, list->numPipelines);
+    for (size_t i = 0; i < list->numPipelines; i++) {
+        struct Pipeline* pipeline = &list->pipelines[i];
+        writeNumber(sb, list->separators[i]);
+        writeNumber(sb, pipeline->bang);
+        writeNumber(sb, pipeline->numCommands);
+        for (size_t j = 0; j < pipeline->numCommands; j++) {
+            if (!writeCommand(sb, &pipeline->commands[j], nesting)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static bool writeCommand(struct StringBuffer* sb, struct Command* command,
+        size_t nesting) {
+    if (++nesting > MAX_NESTING) return false;
+
+    writeNumber(sb, command->type);
+    bool success = true;
+
+    switch (command->type) {
+    case COMMAND_SIMPLE:
+        writeWords(sb, command->simpleCommand.assignmentWords,
+                command->simpleCommand.numAssignmentWords);
+        writeRedirections(sb, command->simpleCommand.redirections,
+                command->simpleCommand.numRedirections);
+        writeWords(sb, command->simpleCommand.words,
+                command->simpleCommand.numWords);
+        break;
+    case COMMAND_SUBSHELL:
+    case COMMAND_BRACE_GROUP:
+        success = writeList(sb, &command->compoundList, nesting);
+        break;
+    case COMMAND_FOR:
+        writeString(sb, command->forClause.name);
+        writeWords(sb, command->forClause.words, command->forClause.numWords);
+        success = writeList(sb, &command->forClause.body, nesting);
+        break;
+    case COMMAND_CASE:
+        writeString(sb, command->caseClause.word->text);
+        writeNumber(sb, command->caseClause.numItems);
+        for (size_t i = 0; i < command->caseClause.numItems && success; i++) {
+            struct CaseItem* item = &command->caseClause.items[i];
+            writeWords(sb, item->patterns, item->numPatterns);
+            writeNumber(sb, item->fallthrough);
+            writeNumber(sb, item->hasList);
+            if (item->hasList) {
+                success = writeList(sb, &item->list, nesting);
+            }
+        }
+        break;
+    case COMMAND_IF:
+        writeNumber(sb, command->ifClause.numConditions);
+        writeNumber(sb, command->ifClause.hasElse);
+        for (size_t i = 0; i < command->ifClause.numConditions && success;
+                i++) {
+            success = writeList(sb, &command->ifClause.conditions[i],
+                    nesting) &&
+                    writeList(sb, &command->ifClause.bodies[i], nesting);
+        }
+        if (command->ifClause.hasElse && success) {
+            success = writeList(sb, &command->ifClause.bodies[
+                    command->ifClause.numConditions], nesting);
+        }
+        break;
+    case COMMAND_WHILE:
+    case COMMAND_UNTIL:
+        success = writeList(sb, &command->loop.condition, nesting) &&
+                writeList(sb, &command->loop.body, nesting);
+        break;
+    case COMMAND_FUNCTION_DEFINITION:
+        writeString(sb, command->function->name);
+        success = writeCommand(sb, &command->function->body, nesting);
+        break;
+    }
+
+    writeRedirections(sb, command->redirections, command->numRedirections);
+    return success;
+}
+
+static void* allocateArray(struct Reader* reader, size_t count, size_t size) {
+    if (count == 0) return NULL;
+    if (count > SIZE_MAX / size) {
+        errno = ENOMEM;
+        err(1, "malloc");
+    }
+    return arenaAllocate(reader->arena, count * size);
+}
+
+static uintmax_t readNumber(struct Reader* reader, uintmax_t max) {
+    uintmax_t result = 0;
+    unsigned int shift = 0;
+
+    while (true) {
+        if (reader->offset >= reader->size ||
+                shift >= sizeof(uintmax_t) * CHAR_BIT) {
+            reader->error = true;
+            return 0;
+        }
+        unsigned char byte = reader->data[reader->offset++];
+        uintmax_t bits = byte & 0x7F;
+        if (bits << shift >> shift != bits) {
+            reader->error = true;
+            return 0;
+        }
+        result |= bits << shift;
+        shift += 7;
+        if (!(byte & 0x80)) break;
+    }
+
+    if (result > max) {
+        reader->error = true;
+        return 0;
+    }
+    return result;
+}
+
+static bool readBool(struct Reader* reader) {
+    return readNumber(reader, 1);
+}
+
+static size_t readCount(struct Reader* reader) {
+    // Every element takes up at least one byte, so larger counts are invalid.
+    return readNumber(reader, reader->size - reader->offset);
+}
+
+static char* readString(struct Reader* reader) {
+    size_t length = readCount(reader);
+    if (reader->error || reader->size - reader->offset < length + 1) {
+        reader->error = true;
+        return NULL;
+    }
+
+    char* string = (char*) reader->data + reader->offset;
+    if (string[length] != '\0' || memchr(string, '\0', length)) {
+        reader->error = true;
+        return NULL;
+    }
+    reader->offset += length + 1;
+    return string;
+}
+
+static struct Word* readWord(struct Reader* reader, bool noQuotes) {
+    char* text = readString(reader);
+    if (reader->error) return NULL;
+    return lexWord(reader->arena, text, noQuotes, NULL);
+}
+
+static bool readWords(struct Reader* reader, struct Word*** words,
+        size_t* numWords) {
+    *numWords = readCount(reader);
+    *words = allocateArray(reader, *numWords, sizeof(struct Word*));
+    for (size_t i = 0; i < *numWords && !reader->error; i++) {
+        (*words)[i] = readWord(reader, false);
+    }
+    return !reader->error;
+}
+
+static bool readRedirections(struct Reader* reader,
+        struct Redirection** redirections, size_t* numRedirections) {
+    *numRedirections = readCount(reader);
+    *redirections = allocateArray(reader, *numRedirections,
+            sizeof(struct Redirection));
+    for (size_t i = 0; i < *numRedirections && !reader->error; i++) {
+        (*redirections)[i].fd = readNumber(reader, INT_MAX);
+        int type = readNumber(reader, REDIR_HERE_DOC_QUOTED);
+        (*redirections)[i].type = type;
+        (*redirections)[i].word = NULL;
+        (*redirections)[i].filename = NULL;
+        if (type == REDIR_HERE_DOC_QUOTED) {
+            (*redirections)[i].filename = readString(reader);
+        } else {
+            (*redirections)[i].word = readWord(reader,
+                    type == REDIR_HERE_DOC);
+        }
+    }
+    return !reader->error;
+}
+
+static bool readList(struct Reader* reader, struct List* list) {
+    if (++reader->nesting > MAX_NESTING) {
+        reader->error = true;
+    }
+
+    list->numPipelines = readCount(reader);
+    if (list->numPipelines == 0) {
+        reader->error = true;
+    }
+    list->pipelines = allocateArray(reader, list->numPipelines,
+            sizeof(struct Pipeline));
+    list->separators = allocateArray(reader, list->numPipelines, 1);
+
+    for (size_t i = 0; i < list->numPipelines && !reader->error; i++) {
+        struct Pipeline* pipeline = &list->pipelines[i];
+        list->separators[i] = readNumber(reader, LIST_SEMI);
+        pipeline->bang = readBool(reader);
+        pipeline->numCommands = readCount(reader);
+        if (pipeline->numCommands == 0) {
+            reader->error = true;
+        }
+        pipeline->commands = allocateArray(reader, pipeline->numCommands,
+                sizeof(struct Command));
+        for (size_t j = 0; j < pipeline->numCommands && !reader->error; j++) {
+            readCommand(reader, &pipeline->commands[j]);
+        }
+    }
+
+    reader->nesting--;
+    return !reader->error;
+}
+
+static bool readFunction(struct Reader* reader, struct Function** function) {
+    // The function is never freed because the syntax tree of the script keeps
+    // a reference to it.
+    struct Function* func = arenaAllocate(reader->arena,
+            sizeof(struct Function));
+    func->refcount = 1;
+    initArena(&func->arena);
+    func->name = readString(reader);
+    if (!reader->error && readCommand(reader, &func->body) &&
+            (func->body.type == COMMAND_SIMPLE ||
+            func->body.type == COMMAND_FUNCTION_DEFINITION)) {
+        reader->error = true;
+    }
+    *function = func;
+    return !reader->error;
+}
+
+static bool readCommand(struct Reader* reader, struct Command* command) {
+    if (++reader->nesting > MAX_NESTING) {
+        reader->error = true;
+        return false;
+    }
+
+    command->type = readNumber(reader, COMMAND_FUNCTION_DEFINITION);
+    command->redirections = NULL;
+    command->numRedirections = 0;
+    if (reader->error) return false;
+
+    switch (command->type) {
+    case COMMAND_SIMPLE:
+        readWords(reader, &command->simpleCommand.assignmentWords,
+                &command->simpleCommand.numAssignmentWords);
+        readRedirections(reader, &command->simpleCommand.redirections,
+                &command->simpleCommand.numRedirections);
+        readWords(reader, &command->simpleCommand.words,
+                &command->simpleCommand.numWords);
+        break;
+    case COMMAND_SUBSHELL:
+    case COMMAND_BRACE_GROUP:
+        readList(reader, &command->compoundList);
+        break;
+    case COMMAND_FOR:
+        command->forClause.name = readString(reader);
+        readWords(reader, &command->forClause.words,
+                &command->forClause.numWords);
+        readList(reader, &command->forClause.body);
+        break;
+    case COMMAND_CASE: {
+        struct CaseClause* clause = &command->caseClause;
+        clause->word = readWord(reader, false);
+        clause->numItems = readCount(reader);
+        clause->items = allocateArray(reader, clause->numItems,
+                sizeof(struct CaseItem));
+        for (size_t i = 0; i < clause->numItems && !reader->error; i++) {
+            struct CaseItem* item = &clause->items[i];
+            readWords(reader, &item->patterns, &item->numPatterns);
+            item->fallthrough = readBool(reader);
+            item->hasList = readBool(reader);
+            if (item->hasList) {
+                readList(reader, &item->list);
+            }
+        }
+        clause->patterns = NULL;
+        if (!reader->error) {
+            clause->patterns = createCasePatterns(reader->arena, clause);
+        }
+    } break;
+    case COMMAND_IF: {
+        struct IfClause* clause = &command->ifClause;
+        clause->numConditions = readCount(reader);
+        clause->hasElse = readBool(reader);
+        if (clause->numConditions == 0) {
+            reader->error = true;
+        }
+        clause->conditions = allocateArray(reader, clause->numConditions,
+                sizeof(struct List));
+        clause->bodies = allocateArray(reader, clause->numConditions + 1,
+                sizeof(struct List));
+        for (size_t i = 0; i < clause->numConditions && !reader->error; i++) {
+            readList(reader, &clause->conditions[i]);
+            readList(reader, &clause->bodies[i]);
+        }
+        if (clause->hasElse && !reader->error) {
+            readList(reader, &clause->bodies[clause->numConditions]);
+        }
+    } break;
+    case COMMAND_WHILE:
+    case COMMAND_UNTIL:
+        readList(reader, &command->loop.condition);
+        readList(reader, &command->loop.body);
+        break;
+    case COMMAND_FUNCTION_DEFINITION:
+        readFunction(reader, &command->function);
+        break;
+    }
+
+    if (!reader->error) {
+        readRedirections(reader, &command->redirections,
+                &command->numRedirections);
+        if (command->type == COMMAND_SIMPLE && command->numRedirections != 0) {
+            reader->error = true;
+        }
+    }
+
+    reader->nesting--;
+    return !reader->error;
+}
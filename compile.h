@@ -0,0 +1,41 @@
+/* Copyright (c) 2026 Dennis Wölfing
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* compile.h
+ * Precompiled scripts.
+ */
+
+#ifndef COMPILE_H
+#define COMPILE_H
+
+#include "parser.h"
+
+struct CompiledScript {
+    // The syntax tree is allocated in this arena and its strings point into
+    // the mapping.
+    struct Arena arena;
+    void* mapping;
+    size_t size;
+    struct CompleteCommand* commands;
+    size_t numCommands;
+    size_t nextCommand;
+};
+
+bool compileScript(const char* inputPath, const char* outputPath);
+bool isCompiledScript(int fd);
+struct CompiledScript* loadCompiledScript(int fd, const char* pathname);
+struct CompleteCommand* nextCompiledCommand(struct CompiledScript* script);
+
+#endif
@@ -1,4 +1,4 @@
-/* Copyright (c) 2016, 2017, 2018, 2019, 2020, 2021, 2022, 2025 Dennis Wölfing
+/* Copyright (c) 2016, 2017, 2018, 2019, 2020, 2021, 2022, 2025, 2026 Dennis Wölfing
  *
  * Permission to use, copy, modify, and/or distribute this software for any
  * purpose with or without fee is hereby granted, provided that the above
@@ -31,9 +31,12 @@
 #include <unistd.h>
 
 #include "builtins.h"
+#include "cache.h"
+#include "compile.h"
 #include "dxsh.h"
 #include "execute.h"
 #include "interactive.h"
+#include "match.h"
 #include "parser.h"
 #include "trap.h"
 #include "variables.h"
@@ -47,7 +50,12 @@ pid_t shellPid;
 
 static char* buffer;
 static size_t bufferSize;
+static struct CompiledScript* compiledScript;
 static char hostname[HOST_NAME_MAX + 1];
+static char inputBuffer[8192];
+static bool inputBuffered;
+static size_t inputBufferOffset;
+static size_t inputBufferUsed;
 static int inputFd;
 static bool interactiveInput;
 static jmp_buf jumpBuffer;
@@ -55,9 +63,11 @@ static const char* username;
 
 static void help(const char* argv0);
 static int parseOptions(int argc, char* argv[]);
-static bool readInputFromFile(const char** str, bool newCommand, void* context);
-static bool readInputFromString(const char** str, bool newCommand,
-        void* context);
+static bool readBufferedInput(const char** str, size_t* length);
+static bool readInputFromFile(const char** str, size_t* length,
+        bool newCommand, void* context);
+static bool readInputFromString(const char** str, size_t* length,
+        bool newCommand, void* context);
 
 int main(int argc, char* argv[]) {
     int optionIndex = parseOptions(argc, argv);
@@ -105,8 +115,8 @@ int main(int argc, char* argv[]) {
         }
     }
 
-    bool (*readInput)(const char** str, bool newCommand, void* context) =
-            readInputFromFile;
+    bool (*readInput)(const char** str, size_t* length, bool newCommand,
+            void* context) = readInputFromFile;
     void* context = NULL;
 
     if (shellOptions.command) {
@@ -140,6 +150,20 @@ int main(int argc, char* argv[]) {
         close(fd);
     }
 
+    // Input from seekable files is read in blocks. For pipes and terminals we
+    // must not read beyond the end of the line because the remaining input
+    // belongs to the utilities invoked by the script.
+    inputBuffered = !isatty(inputFd) && lseek(inputFd, 0, SEEK_CUR) >= 0;
+    inputBufferOffset = 0;
+    inputBufferUsed = 0;
+
+    // Compiled scripts are kept loaded until the shell exits because function
+    // definitions might still refer to them.
+    compiledScript = NULL;
+    if (inputFd != 0 && isCompiledScript(inputFd)) {
+        compiledScript = loadCompiledScript(inputFd, arguments[0]);
+    }
+
     initializeTraps();
 
     inputIsTerminal = isatty(0);
@@ -168,6 +192,17 @@ int main(int argc, char* argv[]) {
             exitShell(lastStatus);
         }
 
+        if (compiledScript) {
+            struct CompleteCommand* command =
+                    nextCompiledCommand(compiledScript);
+            if (command) {
+                execute(command, false);
+            } else {
+                endOfFileReached = true;
+            }
+            continue;
+        }
+
         struct Parser parser;
         initParser(&parser, readInput, context);
         struct CompleteCommand command;
@@ -175,7 +210,8 @@ int main(int argc, char* argv[]) {
         freeParser(&parser);
 
         if (parserResult == PARSER_MATCH) {
-            execute(&command);
+            // The command string of sh -c is parsed as a single command.
+            execute(&command, readInput == readInputFromString);
             freeCompleteCommand(&command);
         } else if (parserResult == PARSER_SYNTAX) {
             lastStatus = 1;
@@ -187,6 +223,8 @@ noreturn void executeScript(int argc, char** argv) {
     // Reset all global state and jump back at the beginning of the shell to
     // execute the script.
     freeCompleteCommand(currentCommand);
+    clearCaches();
+    clearDirectoryCache();
     freeInteractive();
     freeRedirections();
     unsetFunctions();
@@ -232,6 +270,13 @@ bool handleLongOption(bool plusOption, const char* option) {
         shellOptions.allexport = !plusOption;
     } else if (strcmp(option, "errexit") == 0) {
         shellOptions.errexit = !plusOption;
+    } else if (strcmp(option, "globcache") == 0) {
+        shellOptions.globcache = !plusOption;
+        if (plusOption) {
+            clearDirectoryCache();
+        }
+    } else if (strcmp(option, "globstar") == 0) {
+        shellOptions.globstar = !plusOption;
     } else if (strcmp(option, "hashall") == 0) {
         shellOptions.hashall = !plusOption;
     } else if (strcmp(option, "ignoreeof") == 0) {
@@ -269,6 +314,8 @@ static void help(const char* argv0) {
             "  -m, -o monitor           enable job control\n"
             "  -o OPTION                enable OPTION\n"
             "  -s                       read from stdin\n"
+            "      --compile FILE -o OUTPUT\n"
+            "                           compile the script FILE to OUTPUT\n"
             "      --help               display this help\n"
             "      --version            display version info\n",
             argv0);
@@ -289,7 +336,12 @@ static int parseOptions(int argc, char* argv[]) {
 
         if (!plusOption && arg[1] == '-') {
             arg += 2;
-            if (strcmp(arg, "help") == 0) {
+            if (strcmp(arg, "compile") == 0) {
+                if (argc - i != 4 || strcmp(argv[i + 2], "-o") != 0) {
+                    errx(1, "usage: %s --compile FILE -o OUTPUT", argv[0]);
+                }
+                exit(compileScript(argv[i + 1], argv[i + 3]) ? 0 : 1);
+            } else if (strcmp(arg, "help") == 0) {
                 help(argv[0]);
                 exit(0);
             } else if (strcmp(arg, "version") == 0) {
@@ -372,14 +424,18 @@ void printQuoted(const char* string) {
     fputc('\'', stdout);
 }
 
-static bool readInputFromFile(const char** str, bool newCommand,
-        void* context) {
+static bool readInputFromFile(const char** str, size_t* length,
+        bool newCommand, void* context) {
     (void) context;
 
     if (shellOptions.interactive && !endOfFileReached) {
         printPrompt(newCommand);
     }
 
+    if (inputBuffered) {
+        return readBufferedInput(str, length);
+    }
+
     size_t offset = 0;
     sigset_t mask;
     unblockTraps(&mask);
@@ -413,13 +469,63 @@ static bool readInputFromFile(const char** str, bool newCommand,
     blockTraps(&mask);
     if (offset == 0) return false;
 
-    buffer[offset] = '\0';
     *str = buffer;
+    *length = offset;
+    return true;
+}
+
+static bool readBufferedInput(const char** str, size_t* length) {
+    size_t offset = 0;
+
+    while (true) {
+        if (inputBufferOffset == inputBufferUsed) {
+            sigset_t mask;
+            unblockTraps(&mask);
+            ssize_t bytesRead = read(inputFd, inputBuffer, sizeof(inputBuffer));
+            if (bytesRead < 0) err(1, "read");
+            inputBufferOffset = 0;
+            inputBufferUsed = bytesRead;
+            // Trap actions executed here will call syncInput() which discards
+            // the data we just read.
+            blockTraps(&mask);
+
+            if (bytesRead == 0) {
+                endOfFileReached = true;
+                break;
+            }
+            continue;
+        }
+
+        const char* begin = inputBuffer + inputBufferOffset;
+        size_t available = inputBufferUsed - inputBufferOffset;
+        const char* newline = memchr(begin, '\n', available);
+        size_t lineLength = newline ? (size_t) (newline - begin) + 1 :
+                available;
+
+        if (bufferSize < offset + lineLength) {
+            if (bufferSize == 0) bufferSize = 80;
+            while (bufferSize < offset + lineLength) {
+                bufferSize *= 2;
+            }
+            buffer = realloc(buffer, bufferSize);
+            if (!buffer) err(1, "malloc");
+        }
+
+        memcpy(buffer + offset, begin, lineLength);
+        offset += lineLength;
+        inputBufferOffset += lineLength;
+        if (newline) break;
+    }
+
+    if (offset == 0) return false;
+
+    *str = buffer;
+    *length = offset;
     return true;
 }
 
-static bool readInputFromString(const char** str, bool newCommand,
-        void* context) {
+static bool readInputFromString(const char** str, size_t* length,
+        bool newCommand, void* context) {
     (void) newCommand;
 
     const char** word = context;
@@ -428,10 +534,25 @@ static bool readInputFromString(const char** str, bool newCommand,
         return false;
     }
     *str = *word;
+    *length = strlen(*word);
     *word = NULL;
     return true;
 }
 
+// Gives back buffered input that has not been parsed yet. This is called
+// before anything that might read from standard input, so that it sees the
+// input at the position that the shell has actually consumed.
+void syncInput(void) {
+    // The script file is opened on a private file descriptor, so only standard
+    // input is shared with the commands we execute.
+    if (inputFd != 0 || inputBufferOffset == inputBufferUsed) return;
+
+    off_t unread = inputBufferUsed - inputBufferOffset;
+    if (lseek(inputFd, -unread, SEEK_CUR) < 0) err(1, "lseek");
+    inputBufferOffset = 0;
+    inputBufferUsed = 0;
+}
+
 // Utility functions:
 
 void addToArray(void** array, size_t* used, const void* value, size_t size) {
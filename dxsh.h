@@ -1,4 +1,4 @@
-/* Copyright (c) 2018, 2019, 2020, 2022, 2025 Dennis Wölfing
+/* Copyright (c) 2018, 2019, 2020, 2022, 2025, 2026 Dennis Wölfing
  *
  * Permission to use, copy, modify, and/or distribute this software for any
  * purpose with or without fee is hereby granted, provided that the above
@@ -29,6 +29,8 @@
 struct ShellOptions {
     bool allexport; // unimplemented
     bool errexit; // unimplemented
+    bool globcache;
+    bool globstar;
     bool hashall; // unimplemented
     bool ignoreeof; // unimplemented
     bool monitor;
@@ -63,5 +65,6 @@ void addMultipleToArray(void** array, size_t* used, const void* values,
 NO_DISCARD bool moveFd(int old, int new);
 int printPrompt(bool newCommand);
 void printQuoted(const char* string);
+void syncInput(void);
 
 #endif
@@ -1,4 +1,4 @@
-/* Copyright (c) 2018, 2019, 2020, 2021, 2022, 2025 Dennis Wölfing
+/* Copyright (c) 2018, 2019, 2020, 2021, 2022, 2025, 2026 Dennis Wölfing
  *
  * Permission to use, copy, modify, and/or distribute this software for any
  * purpose with or without fee is hereby granted, provided that the above
@@ -24,21 +24,31 @@
 #include <fcntl.h>
 #include <sched.h>
 #include <signal.h>
+#if HAVE_POSIX_SPAWN
+#  include <spawn.h>
+#endif
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdnoreturn.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
 
+#include "arith.h"
 #include "builtins.h"
 #include "execute.h"
 #include "expand.h"
 #include "match.h"
 #include "dxsh.h"
+#include "stringbuffer.h"
 #include "trap.h"
 #include "variables.h"
+#include "word.h"
+
+extern char** environ;
 
 struct Function** functions;
 size_t numFunctions;
@@ -48,6 +58,8 @@ unsigned long numBreaks;
 unsigned long numContinues;
 bool returning;
 int returnStatus;
+// The status of the last command substitution.
+int substitutionStatus;
 
 struct SavedFd {
     int fd;
@@ -57,15 +69,45 @@ struct SavedFd {
 
 static struct SavedFd* savedFds;
 
-static int executeCommand(struct Command* command, bool subshell);
-static int executeCompoundCommand(struct Command* command, bool subshell);
+// Collected while checking whether a command substitution can be executed
+// without forking.
+struct InProcessState {
+    struct Arena arena;
+    struct SavedVariable* variables;
+    size_t numVariables;
+    // Functions whose bodies are currently being checked.
+    struct Function** functions;
+    size_t numFunctions;
+};
+
+// Builtins that do not change any shell state except for the umask.
+static const char* const inProcessBuiltins[] = {
+    ":", "break", "continue", "return", "umask", NULL
+};
+
+static bool checkCommand(struct Command* command,
+        struct InProcessState* state);
+static bool checkList(struct List* list, struct InProcessState* state);
+static bool checkRedirections(struct Redirection* redirections,
+        size_t numRedirections, struct InProcessState* state);
+static bool checkSimpleCommand(struct SimpleCommand* command,
+        struct InProcessState* state);
+static bool checkWord(const struct Word* word, struct InProcessState* state);
+#if HAVE_POSIX_SPAWN
+static char** buildEnvironment(char** assignments, size_t numAssignments);
+#endif
+static int executeCommand(struct Command* command, bool subshell, bool tail);
+static int executeCompoundCommand(struct Command* command, bool subshell,
+        bool tail);
 static int executeFor(struct ForClause* clause);
 static int executeFunction(struct Function* function, int argc, char** argv);
-static int executeCase(struct CaseClause* clause);
-static int executeList(struct List* list);
-static int executePipeline(struct Pipeline* pipeline);
+static bool executeInProcess(struct CompleteCommand* command,
+        struct StringBuffer* sb, int* status);
+static int executeCase(struct CaseClause* clause, bool tail);
+static int executeList(struct List* list, bool tail);
+static int executePipeline(struct Pipeline* pipeline, bool tail);
 static int executeSimpleCommand(struct SimpleCommand* simpleCommand,
-        bool subshell);
+        bool subshell, bool tail);
 static bool expandSimpleCommand(const struct SimpleCommand* simpleCommand,
         struct ExpandedSimpleCommand* expanded);
 static void freeExpandedSimpleCommand(struct ExpandedSimpleCommand* expanded);
@@ -73,12 +115,25 @@ static bool performRedirection(struct Redirection* redirection, bool noSave);
 static bool performRedirections(struct Redirection* redirections,
         size_t numRedirections, bool noSave);
 static void popRedirection(void);
+static void releaseSavedVariables(struct InProcessState* state,
+        bool restore);
+static void saveArithmeticAssignment(const char* name, void* state);
+static void saveAssignedVariable(const char* name, size_t length,
+        struct InProcessState* state);
+static bool spawnSubstitution(struct CompleteCommand* command, int fd,
+        pid_t* pid, int* status);
+#if HAVE_POSIX_SPAWN
+static pid_t spawnUtility(struct ExpandedSimpleCommand* expanded,
+        const char* path, int* status);
+#endif
 static int waitForCommand(pid_t pid);
 
-int execute(struct CompleteCommand* command) {
+// If lastCommand is true, nothing else will be executed by this process
+// afterwards, so the final utility may replace the shell.
+int execute(struct CompleteCommand* command, bool lastCommand) {
     command->prevCommand = currentCommand;
     currentCommand = command;
-    int result = executeList(&command->list);
+    int result = executeList(&command->list, lastCommand);
     currentCommand = command->prevCommand;
     command->prevCommand = NULL;
     if (returning) {
@@ -89,42 +144,396 @@ int execute(struct CompleteCommand* command) {
 }
 
 int executeAndRead(struct CompleteCommand* command, struct StringBuffer* sb) {
+    int status;
+    if (executeInProcess(command, sb, &status)) return status;
+
     int pipeFds[2];
     if (pipe(pipeFds) < 0) err(1, "pipe");
+    fcntl(pipeFds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(pipeFds[1], F_SETFD, FD_CLOEXEC);
 
-    pid_t pid = fork();
-    if (pid < 0) {
-        err(1, "fork");
-    } else if (pid == 0) {
-        close(pipeFds[0]);
-        if (!moveFd(pipeFds[1], 1)) err(1, "cannot move file descriptor");
+    syncInput();
+    pid_t pid;
+    if (!spawnSubstitution(command, pipeFds[1], &pid, &status)) {
+        pid = fork();
+        if (pid < 0) {
+            err(1, "fork");
+        } else if (pid == 0) {
+            close(pipeFds[0]);
+            if (!moveFd(pipeFds[1], 1)) {
+                err(1, "cannot move file descriptor");
+            }
 
-        resetTraps();
-        exitShell(execute(command));
-    } else {
-        close(pipeFds[1]);
+            resetTraps();
+            exitShell(execute(command, true));
+        }
+    }
+    close(pipeFds[1]);
 
-        while (true) {
-            char buffer[4096 + 1];
+    while (true) {
+        char buffer[4096 + 1];
 
-            ssize_t bytesRead = read(pipeFds[0], buffer, sizeof(buffer) - 1);
-            if (bytesRead < 0) {
-                err(1, "read");
-            } else if (bytesRead == 0) {
-                break;
-            } else {
-                buffer[bytesRead] = '\0';
-                appendStringToStringBuffer(sb, buffer);
+        ssize_t bytesRead = read(pipeFds[0], buffer, sizeof(buffer) - 1);
+        if (bytesRead < 0) {
+            err(1, "read");
+        } else if (bytesRead == 0) {
+            break;
+        } else {
+            buffer[bytesRead] = '\0';
+            appendStringToStringBuffer(sb, buffer);
+        }
+    }
+    close(pipeFds[0]);
+
+    if (pid < 0) return status;
+    return waitForCommand(pid);
+}
+
+static void saveAssignedVariable(const char* name, size_t length,
+        struct InProcessState* state) {
+    char* copy = arenaStrndup(&state->arena, name, length);
+    if (!isRegularVariableName(copy)) return;
+    for (size_t i = 0; i < state->numVariables; i++) {
+        if (strcmp(state->variables[i].name, copy) == 0) return;
+    }
+
+    struct SavedVariable saved;
+    saveVariable(copy, &saved);
+    addToArray((void**) &state->variables, &state->numVariables, &saved,
+            sizeof(saved));
+}
+
+static void saveArithmeticAssignment(const char* name, void* state) {
+    saveAssignedVariable(name, strlen(name), state);
+}
+
+static bool checkWord(const struct Word* word, struct InProcessState* state) {
+    for (size_t i = 0; i < word->numParts; i++) {
+        const struct WordPart* part = &word->parts[i];
+        if (part->type == WORDPART_INVALID) return false;
+        if (part->type == WORDPART_ARITHMETIC) {
+            // Variables assigned by expressions that contain substitutions
+            // are only known after expanding them.
+            if (!part->arithmetic) return false;
+            findArithmeticAssignments(part->arithmetic,
+                    saveArithmeticAssignment, state);
+            continue;
+        }
+        if (part->type != WORDPART_PARAMETER) continue;
+
+        // ${name?word} exits the shell when the parameter is not set.
+        struct Parameter* param = part->parameter;
+        if (param->op == '?') return false;
+        if (param->op == '=') {
+            saveAssignedVariable(param->name, strlen(param->name), state);
+        }
+        if (param->argument && !checkWord(param->argument, state)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool checkRedirections(struct Redirection* redirections,
+        size_t numRedirections, struct InProcessState* state) {
+    for (size_t i = 0; i < numRedirections; i++) {
+        if (redirections[i].type == REDIR_HERE_DOC_QUOTED) continue;
+        if (!checkWord(redirections[i].word, state)) return false;
+    }
+    return true;
+}
+
+static bool checkSimpleCommand(struct SimpleCommand* command,
+        struct InProcessState* state) {
+    for (size_t i = 0; i < command->numAssignmentWords; i++) {
+        const struct Word* word = command->assignmentWords[i];
+        saveAssignedVariable(word->text, strcspn(word->text, "="), state);
+        if (!checkWord(word, state)) return false;
+    }
+    if (!checkRedirections(command->redirections, command->numRedirections,
+            state)) {
+        return false;
+    }
+    for (size_t i = 0; i < command->numWords; i++) {
+        if (!checkWord(command->words[i], state)) return false;
+    }
+    if (command->numWords == 0) return true;
+
+    // The command name must not depend on any expansions.
+    if (!command->words[0]->literal) return false;
+    const char* name = command->words[0]->text;
+
+    const struct builtin* builtin = NULL;
+    struct Function* function = NULL;
+    findBuiltinOrFunction(name, &builtin, &function);
+
+    // Temporary assignments for builtins and functions are undone by
+    // popVariables() which would also undo those of the calling command.
+    if (command->numAssignmentWords > 0 &&
+            (!builtin || !(builtin->flags & BUILTIN_SPECIAL))) {
+        return false;
+    }
+
+    if (function) {
+        for (size_t i = 0; i < state->numFunctions; i++) {
+            if (state->functions[i] == function) return true;
+        }
+
+        addToArray((void**) &state->functions, &state->numFunctions,
+                &function, sizeof(struct Function*));
+        bool result = checkCommand(&function->body, state);
+        state->numFunctions--;
+        return result;
+    }
+
+    if (!builtin) return false;
+    for (const char* const* b = inProcessBuiltins; *b; b++) {
+        if (strcmp(builtin->name, *b) == 0) return true;
+    }
+
+    if (strcmp(builtin->name, "command") == 0 && command->numWords >= 2) {
+        const struct Word* option = command->words[1];
+        return option->literal && (strcmp(option->text, "-v") == 0 ||
+                strcmp(option->text, "-V") == 0);
+    }
+    return false;
+}
+
+static bool checkCommand(struct Command* command,
+        struct InProcessState* state) {
+    if (command->type == COMMAND_SIMPLE) {
+        return checkSimpleCommand(&command->simpleCommand, state);
+    }
+
+    if (!checkRedirections(command->redirections, command->numRedirections,
+            state)) {
+        return false;
+    }
+
+    switch (command->type) {
+    case COMMAND_BRACE_GROUP:
+        return checkList(&command->compoundList, state);
+    case COMMAND_FOR: {
+        struct ForClause* clause = &command->forClause;
+        saveAssignedVariable(clause->name, strlen(clause->name), state);
+        for (size_t i = 0; i < clause->numWords; i++) {
+            if (!checkWord(clause->words[i], state)) return false;
+        }
+        return checkList(&clause->body, state);
+    }
+    case COMMAND_CASE: {
+        struct CaseClause* clause = &command->caseClause;
+        if (!checkWord(clause->word, state)) return false;
+        for (size_t i = 0; i < clause->numItems; i++) {
+            struct CaseItem* item = &clause->items[i];
+            for (size_t j = 0; j < item->numPatterns; j++) {
+                if (!checkWord(item->patterns[j], state)) return false;
             }
+            if (item->hasList && !checkList(&item->list, state)) return false;
+        }
+        return true;
+    }
+    case COMMAND_IF: {
+        struct IfClause* clause = &command->ifClause;
+        for (size_t i = 0; i < clause->numConditions; i++) {
+            if (!checkList(&clause->conditions[i], state)) return false;
         }
+        size_t numBodies = clause->numConditions + clause->hasElse;
+        for (size_t i = 0; i < numBodies; i++) {
+            if (!checkList(&clause->bodies[i], state)) return false;
+        }
+        return true;
+    }
+    case COMMAND_WHILE:
+    case COMMAND_UNTIL:
+        return checkList(&command->loop.condition, state) &&
+                checkList(&command->loop.body, state);
+    default:
+        // Subshells would fork anyway and function definitions cannot be
+        // undone.
+        return false;
+    }
+}
 
-        return waitForCommand(pid);
+static bool checkList(struct List* list, struct InProcessState* state) {
+    for (size_t i = 0; i < list->numPipelines; i++) {
+        struct Pipeline* pipeline = &list->pipelines[i];
+        if (pipeline->numCommands != 1) return false;
+        if (!checkCommand(&pipeline->commands[0], state)) return false;
     }
+    return true;
 }
 
-static int executeList(struct List* list) {
+// Executes a command substitution without forking if it only consists of
+// builtins and functions that do not need a separate process. The shell state
+// that the command can change is restored afterwards.
+static bool executeInProcess(struct CompleteCommand* command,
+        struct StringBuffer* sb, int* status) {
+#if HAVE_MEMFD_CREATE
+    for (struct CompleteCommand* c = currentCommand; c; c = c->prevCommand) {
+        // The command is already being executed by an outer substitution.
+        if (c == command) return false;
+    }
+    if (variablesPushed > 0) return false;
+
+    struct InProcessState state = {0};
+    initArena(&state.arena);
+    bool canExecute = checkList(&command->list, &state);
+    freeArena(&state.arena);
+    free(state.functions);
+
+    int fd = -1;
+    if (canExecute) {
+        fd = memfd_create("dxsh", MFD_CLOEXEC);
+    }
+    if (fd < 0) {
+        releaseSavedVariables(&state, false);
+        return false;
+    }
+
+    fflush(stdout);
+    int savedStdout = fcntl(1, F_DUPFD_CLOEXEC, 10);
+    if (dup2(fd, 1) < 0) err(1, "dup2");
+
+    mode_t mask = umask(0);
+    umask(mask);
+    int oldStatus = lastStatus;
+    unsigned long oldBreaks = numBreaks;
+    unsigned long oldContinues = numContinues;
+    bool oldExecutingTrap = executingTrap;
+    // Traps are not executed in subshells.
+    executingTrap = true;
+
+    *status = execute(command, false);
+
+    executingTrap = oldExecutingTrap;
+    numContinues = oldContinues;
+    numBreaks = oldBreaks;
+    lastStatus = oldStatus;
+    umask(mask);
+    releaseSavedVariables(&state, true);
+
+    fflush(stdout);
+    if (savedStdout >= 0) {
+        dup2(savedStdout, 1);
+        close(savedStdout);
+    } else {
+        close(1);
+    }
+
+    if (lseek(fd, 0, SEEK_SET) < 0) err(1, "lseek");
+    while (true) {
+        reserveStringBuffer(sb, 4096);
+        ssize_t bytesRead = read(fd, sb->buffer + sb->used,
+                sb->allocated - sb->used - 1);
+        if (bytesRead < 0) err(1, "read");
+        if (bytesRead == 0) break;
+        sb->used += bytesRead;
+    }
+    close(fd);
+    return true;
+#else
+    (void) command;
+    (void) sb;
+    (void) status;
+    return false;
+#endif
+}
+
+static void releaseSavedVariables(struct InProcessState* state,
+        bool restore) {
+    for (size_t i = state->numVariables; i > 0; i--) {
+        struct SavedVariable* saved = &state->variables[i - 1];
+        if (restore) {
+            restoreVariable(saved);
+        } else {
+            free(saved->name);
+            free(saved->value);
+        }
+    }
+    free(state->variables);
+}
+
+// Starts a command substitution that consists of a single external utility
+// directly from the shell instead of forking a subshell that would fork again.
+// Returns false if the substitution needs a subshell.
+static bool spawnSubstitution(struct CompleteCommand* command, int fd,
+        pid_t* pid, int* status) {
+#if HAVE_POSIX_SPAWN
+    if (shellOptions.monitor || variablesPushed > 0) return false;
+    struct List* list = &command->list;
+    if (list->numPipelines != 1) return false;
+    struct Pipeline* pipeline = &list->pipelines[0];
+    if (pipeline->numCommands != 1 || pipeline->bang) return false;
+    if (pipeline->commands[0].type != COMMAND_SIMPLE) return false;
+
+    struct SimpleCommand* simpleCommand = &pipeline->commands[0].simpleCommand;
+    if (simpleCommand->numWords == 0) return false;
+    if (!simpleCommand->words[0]->literal) return false;
+    const char* name = simpleCommand->words[0]->text;
+
+    const struct builtin* builtin = NULL;
+    struct Function* function = NULL;
+    findBuiltinOrFunction(name, &builtin, &function);
+    if (builtin || function) return false;
+
+    // The words are expanded in the shell, so the variables that they assign
+    // need to be restored afterwards. Assignment words only go to the
+    // environment of the utility.
+    struct InProcessState state = {0};
+    initArena(&state.arena);
+    bool canSpawn = checkRedirections(simpleCommand->redirections,
+            simpleCommand->numRedirections, &state);
+    for (size_t i = 0; canSpawn && i < simpleCommand->numAssignmentWords;
+            i++) {
+        canSpawn = checkWord(simpleCommand->assignmentWords[i], &state);
+    }
+    for (size_t i = 0; canSpawn && i < simpleCommand->numWords; i++) {
+        canSpawn = checkWord(simpleCommand->words[i], &state);
+    }
+    freeArena(&state.arena);
+    free(state.functions);
+    if (!canSpawn) {
+        releaseSavedVariables(&state, false);
+        return false;
+    }
+
+    struct ExpandedSimpleCommand expanded;
+    bool success = expandSimpleCommand(simpleCommand, &expanded);
+    releaseSavedVariables(&state, true);
+    if (!success) {
+        *pid = -1;
+        *status = 1;
+        return true;
+    }
+
+    fflush(stdout);
+    int savedStdout = fcntl(1, F_DUPFD_CLOEXEC, 10);
+    if (dup2(fd, 1) < 0) err(1, "dup2");
+    *pid = spawnUtility(&expanded, NULL, status);
+    if (savedStdout >= 0) {
+        dup2(savedStdout, 1);
+        close(savedStdout);
+    } else {
+        close(1);
+    }
+
+    freeExpandedSimpleCommand(&expanded);
+    return true;
+#else
+    (void) command;
+    (void) fd;
+    (void) pid;
+    (void) status;
+    return false;
+#endif
+}
+
+// In tail position the list is the last thing executed by the process.
+static int executeList(struct List* list, bool tail) {
     for (size_t i = 0; i < list->numPipelines; i++) {
-        lastStatus = executePipeline(&list->pipelines[i]);
+        lastStatus = executePipeline(&list->pipelines[i],
+                tail && i == list->numPipelines - 1);
         if (returning || numBreaks || numContinues) return 0;
         while (list->separators[i] == LIST_AND && lastStatus != 0) i++;
         while (list->separators[i] == LIST_OR && lastStatus == 0) i++;
@@ -132,15 +541,17 @@ static int executeList(struct List* list) {
     return lastStatus;
 }
 
-static int executePipeline(struct Pipeline* pipeline) {
+static int executePipeline(struct Pipeline* pipeline, bool tail) {
     if (pipeline->numCommands <= 1) {
-        int status = executeCommand(&pipeline->commands[0], false);
+        int status = executeCommand(&pipeline->commands[0], false,
+                tail && !pipeline->bang);
         if (pipeline->bang) {
             status = !status;
         }
         return status;
     }
 
+    syncInput();
     int inputFd = -1;
     pid_t pgid = -1;
 
@@ -203,7 +614,7 @@ static int executePipeline(struct Pipeline* pipeline) {
             }
 
             resetSignals();
-            exit(executeCommand(&pipeline->commands[i], true));
+            exit(executeCommand(&pipeline->commands[i], true, true));
         } else {
             if (shellOptions.monitor && firstInPipeline) {
                 close(pgidPipe[0]);
@@ -265,7 +676,7 @@ static void addFunction(struct Function* function) {
             sizeof(struct Function*));
 }
 
-static int executeCommand(struct Command* command, bool subshell) {
+static int executeCommand(struct Command* command, bool subshell, bool tail) {
     if (!executingTrap) {
         executeTraps();
     }
@@ -275,7 +686,7 @@ static int executeCommand(struct Command* command, bool subshell) {
     }
 
     if (command->type == COMMAND_SIMPLE) {
-        return executeSimpleCommand(&command->simpleCommand, subshell);
+        return executeSimpleCommand(&command->simpleCommand, subshell, tail);
     } else if (command->type == COMMAND_FUNCTION_DEFINITION) {
         addFunction(command->function);
         return 0;
@@ -285,7 +696,7 @@ static int executeCommand(struct Command* command, bool subshell) {
             if (redirection.type != REDIR_HERE_DOC_QUOTED) {
                 int flags = redirection.type == REDIR_HERE_DOC ?
                         EXPAND_NO_QUOTES : 0;
-                redirection.filename = expandWord2(redirection.filename, flags);
+                redirection.filename = expandWord2(redirection.word, flags);
                 if (!redirection.filename) {
                     for (; i > 0; i--) {
                         popRedirection();
@@ -307,7 +718,7 @@ static int executeCommand(struct Command* command, bool subshell) {
             }
         }
 
-        int status = executeCompoundCommand(command, subshell);
+        int status = executeCompoundCommand(command, subshell, tail);
 
         for (size_t i = 0; i < command->numRedirections; i++) {
             popRedirection();
@@ -316,39 +727,42 @@ static int executeCommand(struct Command* command, bool subshell) {
     }
 }
 
-static int executeCompoundCommand(struct Command* command, bool subshell) {
+static int executeCompoundCommand(struct Command* command, bool subshell,
+        bool tail) {
+    tail = tail || subshell;
     int status = 0;
     switch (command->type) {
     case COMMAND_SUBSHELL:
         if (!subshell) {
+            syncInput();
             pid_t pid = fork();
             if (pid < 0) {
                 err(1, "fork");
             } else if (pid == 0) {
                 resetTraps();
-                exit(executeList(&command->compoundList));
+                exit(executeList(&command->compoundList, true));
             } else {
                 return waitForCommand(pid);
             }
         }
-        return executeList(&command->compoundList);
+        return executeList(&command->compoundList, tail);
     case COMMAND_BRACE_GROUP:
-        return executeList(&command->compoundList);
+        return executeList(&command->compoundList, tail);
     case COMMAND_FOR:
         return executeFor(&command->forClause);
     case COMMAND_CASE:
-        return executeCase(&command->caseClause);
+        return executeCase(&command->caseClause, tail);
     case COMMAND_IF:
         for (size_t i = 0; i < command->ifClause.numConditions; i++) {
-            if (executeList(&command->ifClause.conditions[i]) == 0) {
+            if (executeList(&command->ifClause.conditions[i], false) == 0) {
                 if (returning || numBreaks || numContinues) return 0;
-                return executeList(&command->ifClause.bodies[i]);
+                return executeList(&command->ifClause.bodies[i], tail);
             }
             if (returning || numBreaks || numContinues) return 0;
         }
         if (command->ifClause.hasElse) {
             return executeList(&command->ifClause.bodies[
-                    command->ifClause.numConditions]);
+                    command->ifClause.numConditions], tail);
         }
         return 0;
     case COMMAND_WHILE:
@@ -356,7 +770,7 @@ static int executeCompoundCommand(struct Command* command, bool subshell) {
         bool isUntil = command->type == COMMAND_UNTIL;
         loopCounter++;
         while (true) {
-            bool condition = executeList(&command->loop.condition) == 0;
+            bool condition = executeList(&command->loop.condition, false) == 0;
             if (returning) break;
             if (numBreaks) {
                 numBreaks--;
@@ -369,7 +783,7 @@ static int executeCompoundCommand(struct Command* command, bool subshell) {
             }
             if (condition == isUntil) break;
 
-            status = executeList(&command->loop.body);
+            status = executeList(&command->loop.body, false);
 
             if (returning) break;
             if (numBreaks) {
@@ -395,18 +809,13 @@ static int executeFor(struct ForClause* clause) {
     char** items = NULL;
     size_t numItems = 0;
     for (size_t i = 0; i < clause->numWords; i++) {
-        char** fields;
-        ssize_t numFields = expand(clause->words[i], EXPAND_PATHNAMES, &fields);
-        if (numFields < 0) {
+        if (!expand(clause->words[i], EXPAND_PATHNAMES, &items, &numItems)) {
             for (size_t j = 0; j < numItems; j++) {
                 free(items[j]);
             }
             free(items);
             return 1;
         }
-        addMultipleToArray((void**) &items, &numItems, fields, sizeof(char*),
-                numFields);
-        free(fields);
     }
 
     loopCounter++;
@@ -414,7 +823,7 @@ static int executeFor(struct ForClause* clause) {
     size_t i;
     for (i = 0; i < numItems; i++) {
         setVariable(clause->name, items[i], false);
-        status = executeList(&clause->body);
+        status = executeList(&clause->body, false);
         if (returning) break;
         if (numBreaks) {
             numBreaks--;
@@ -451,7 +860,7 @@ static int executeFunction(struct Function* function, int argc, char** argv) {
     numArguments = argc - 1;
 
     function->refcount++;
-    int result = executeCommand(&function->body, false);
+    int result = executeCommand(&function->body, false, false);
     freeFunction(function);
 
     for (int i = 1; i <= numArguments; i++) {
@@ -469,44 +878,37 @@ static int executeFunction(struct Function* function, int argc, char** argv) {
     return result;
 }
 
-static int executeCase(struct CaseClause* clause) {
+static int executeCase(struct CaseClause* clause, bool tail) {
     char* word = expandWord(clause->word);
     if (!word) return 1;
 
-    int status = 0;
-    for (size_t i = 0; i < clause->numItems; i++) {
-        struct CaseItem* item = &clause->items[i];
+    size_t i = findCaseItem(clause->patterns, word);
+    free(word);
+    if (i == SIZE_MAX) return 0;
 
-        for (size_t j = 0; j < item->numPatterns; j++) {
-            if (matchesPattern(word, item->patterns[j])) {
-                if (item->hasList) {
-                    status = executeList(&item->list);
-                }
-                if (item->fallthrough && !returning && !numBreaks &&
-                        !numContinues) {
-                    for (i = i + 1; i < clause->numItems; i++) {
-                        item = &clause->items[i];
-                        if (item->hasList) {
-                            status = executeList(&item->list);
-                        }
-                        if (!item->fallthrough) break;
-                    }
-                }
-                free(word);
-                return status;
+    int status = 0;
+    struct CaseItem* item = &clause->items[i];
+    if (item->hasList) {
+        status = executeList(&item->list, tail && !item->fallthrough);
+    }
+    if (item->fallthrough && !returning && !numBreaks && !numContinues) {
+        for (i = i + 1; i < clause->numItems; i++) {
+            item = &clause->items[i];
+            if (item->hasList) {
+                status = executeList(&item->list, tail && !item->fallthrough);
             }
+            if (!item->fallthrough) break;
         }
     }
-    free(word);
     return status;
 }
 
-static bool isDeclarationUtility(char** words, size_t numWords) {
+static bool isDeclarationUtility(struct Word** words, size_t numWords) {
     if (numWords == 0) return false;
-    if (strcmp(words[0], "export") == 0) {
+    if (strcmp(words[0]->text, "export") == 0) {
         return true;
     }
-    if (strcmp(words[0], "command") == 0) {
+    if (strcmp(words[0]->text, "command") == 0) {
         return isDeclarationUtility(words + 1, numWords - 1);
     }
     return false;
@@ -528,27 +930,25 @@ static bool expandSimpleCommand(const struct SimpleCommand* simpleCommand,
     expanded->arguments = NULL;
     expanded->numArguments = 0;
     for (size_t i = 0; i < simpleCommand->numWords; i++) {
-        char** fields;
         int flags = EXPAND_PATHNAMES;
         if (declUtility) {
-            char* equals = strchr(simpleCommand->words[i], '=');
+            const char* text = simpleCommand->words[i]->text;
+            const char* equals = strchr(text, '=');
             if (equals) {
-                *equals = '\0';
-                if (isRegularVariableName(simpleCommand->words[i])) {
+                char* name = strndup(text, equals - text);
+                if (!name) err(1, "strndup");
+                if (isRegularVariableName(name)) {
                     flags = EXPAND_NO_FIELD_SPLIT;
                 }
-                *equals = '=';
+                free(name);
             }
         }
 
-        ssize_t numFields = expand(simpleCommand->words[i], flags, &fields);
-        if (numFields < 0) {
+        if (!expand(simpleCommand->words[i], flags, &expanded->arguments,
+                &expanded->numArguments)) {
             freeExpandedSimpleCommand(expanded);
             return false;
         }
-        addMultipleToArray((void**) &expanded->arguments,
-                &expanded->numArguments, fields, sizeof(char*), numFields);
-        free(fields);
     }
 
     addToArray((void**) &expanded->arguments, &expanded->numArguments,
@@ -560,7 +960,7 @@ static bool expandSimpleCommand(const struct SimpleCommand* simpleCommand,
             int flags = expanded->redirections[i].type == REDIR_HERE_DOC ?
                     EXPAND_NO_QUOTES : 0;
             expanded->redirections[i].filename =
-                    expandWord2(expanded->redirections[i].filename, flags);
+                    expandWord2(expanded->redirections[i].word, flags);
             if (!expanded->redirections[i].filename) {
                 freeExpandedSimpleCommand(expanded);
                 return false;
@@ -600,14 +1000,35 @@ void findBuiltinOrFunction(const char* command, const struct builtin** builtin,
 }
 
 static int executeSimpleCommand(struct SimpleCommand* simpleCommand,
-        bool subshell) {
+        bool subshell, bool tail) {
+    substitutionStatus = 0;
     struct ExpandedSimpleCommand expandedCommand;
     if (!expandSimpleCommand(simpleCommand, &expandedCommand)) {
         if (subshell) _Exit(1);
         return 1;
     }
 
+    // A utility that is the last command of the process replaces the shell
+    // unless a trap might still need to run. With job control the utility
+    // needs its own process group.
+    if (tail && !subshell && !shellOptions.monitor && !hasTraps() &&
+            expandedCommand.arguments[0]) {
+        const struct builtin* builtin = NULL;
+        struct Function* function = NULL;
+        findBuiltinOrFunction(expandedCommand.arguments[0], &builtin,
+                &function);
+        if (!builtin && !function) {
+            resetSignals();
+            subshell = true;
+        }
+    }
+
     int status = executeExpandedCommand(&expandedCommand, subshell, true, NULL);
+    // Without a command name the status is that of the last command
+    // substitution.
+    if (!expandedCommand.arguments[0] && status == 0) {
+        status = substitutionStatus;
+    }
     freeExpandedSimpleCommand(&expandedCommand);
     return status;
 }
@@ -643,6 +1064,18 @@ int executeExpandedCommand(struct ExpandedSimpleCommand* expanded,
     }
 
     if (!builtin && !function && !subshell) {
+        syncInput();
+#if HAVE_POSIX_SPAWN
+        // Process groups and terminal control need code in the child.
+        if (!shellOptions.monitor) {
+            pid_t pid = spawnUtility(expanded, path, &result);
+            if (pid >= 0) {
+                result = waitForCommand(pid);
+            }
+            goto cleanup;
+        }
+#endif
+
         pid_t pid = fork();
 
         if (pid < 0) {
@@ -680,6 +1113,8 @@ int executeExpandedCommand(struct ExpandedSimpleCommand* expanded,
 
     if (builtin) {
         result = builtin->func(argc, expanded->arguments);
+        // The output must be written before redirections are undone.
+        fflush(stdout);
     } else if (function) {
         result = executeFunction(function, argc, expanded->arguments);
     } else {
@@ -720,6 +1155,106 @@ static void freeExpandedSimpleCommand(struct ExpandedSimpleCommand* expanded) {
     }
 }
 
+#if HAVE_POSIX_SPAWN
+// Returns the environment for a utility with the given assignments.
+static char** buildEnvironment(char** assignments, size_t numAssignments) {
+    if (numAssignments == 0) return environ;
+
+    size_t numVariables = 0;
+    while (environ[numVariables]) numVariables++;
+
+    char** envp = malloc((numVariables + numAssignments + 1) * sizeof(char*));
+    if (!envp) err(1, "malloc");
+    memcpy(envp, environ, numVariables * sizeof(char*));
+
+    for (size_t i = 0; i < numAssignments; i++) {
+        size_t nameLength = strcspn(assignments[i], "=") + 1;
+        size_t j;
+        for (j = 0; j < numVariables; j++) {
+            if (strncmp(envp[j], assignments[i], nameLength) == 0) break;
+        }
+        envp[j] = assignments[i];
+        if (j == numVariables) numVariables++;
+    }
+    envp[numVariables] = NULL;
+    return envp;
+}
+
+// Starts an external utility without forking the shell. Redirections are
+// performed in the shell and inherited by the utility. Returns the pid of the
+// utility, or -1 with the exit status stored in status if it was not started.
+static pid_t spawnUtility(struct ExpandedSimpleCommand* expanded,
+        const char* path, int* status) {
+    for (size_t i = 0; i < expanded->numAssignments; i++) {
+        // The utility is searched for using the assigned PATH.
+        if (strncmp(expanded->assignments[i], "PATH=", 5) == 0) {
+            path = expanded->assignments[i] + 5;
+        }
+    }
+
+    if (!performRedirections(expanded->redirections,
+            expanded->numRedirections, false)) {
+        *status = 1;
+        return -1;
+    }
+
+    int argc = expanded->numArguments - 1;
+    char** arguments = expanded->arguments;
+    const char* command = arguments[0];
+    char* toBeFreed = NULL;
+    if (!strchr(command, '/')) {
+        toBeFreed = getExecutablePath(command, true, path);
+        command = toBeFreed;
+    }
+
+    pid_t pid = -1;
+    if (!command) {
+        warnx("'%s': Command not found", arguments[0]);
+        *status = 127;
+    } else {
+        posix_spawnattr_t attr;
+        posix_spawnattr_init(&attr);
+        posix_spawnattr_setflags(&attr,
+                POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK);
+        sigset_t set;
+        getSignalsToReset(&set);
+        posix_spawnattr_setsigdefault(&attr, &set);
+        sigemptyset(&set);
+        posix_spawnattr_setsigmask(&attr, &set);
+
+        char** envp = buildEnvironment(expanded->assignments,
+                expanded->numAssignments);
+        int error = posix_spawn(&pid, command, NULL, &attr, arguments, envp);
+        posix_spawnattr_destroy(&attr);
+        if (envp != environ) free(envp);
+
+        if (error == ENOEXEC) {
+            // The file needs to be executed as a shell script.
+            pid = fork();
+            if (pid < 0) {
+                err(1, "fork");
+            } else if (pid == 0) {
+                resetSignals();
+                arguments[0] = (char*) command;
+                executeUtility(argc, arguments, expanded->assignments,
+                        expanded->numAssignments, NULL);
+            }
+        } else if (error != 0) {
+            errno = error;
+            warn("execv: '%s'", command);
+            *status = 126;
+            pid = -1;
+        }
+    }
+
+    free(toBeFreed);
+    for (size_t i = 0; i < expanded->numRedirections; i++) {
+        popRedirection();
+    }
+    return pid;
+}
+#endif
+
 noreturn void executeUtility(int argc, char** arguments, char** assignments,
         size_t numAssignments, const char* path) {
     const char* command = arguments[0];
@@ -741,6 +1276,7 @@ noreturn void executeUtility(int argc, char** arguments, char** assignments,
     }
 
     if (command) {
+        syncInput();
         execv(command, arguments);
 
         if (errno == ENOEXEC) {
@@ -906,6 +1442,12 @@ static bool performRedirection(struct Redirection* redirection, bool noSave) {
         }
     }
 
+    // Once standard input is replaced the buffered input can no longer be
+    // given back.
+    if (redirection->fd == 0) {
+        syncInput();
+    }
+
     if (noSave) {
         if (fd != redirection->fd) {
             close(redirection->fd);
@@ -1,4 +1,4 @@
-/* Copyright (c) 2018, 2021, 2022, 2025 Dennis Wölfing
+/* Copyright (c) 2018, 2021, 2022, 2025, 2026 Dennis Wölfing
  *
  * Permission to use, copy, modify, and/or distribute this software for any
  * purpose with or without fee is hereby granted, provided that the above
@@ -41,8 +41,9 @@ extern unsigned long numBreaks;
 extern unsigned long numContinues;
 extern bool returning;
 extern int returnStatus;
+extern int substitutionStatus;
 
-int execute(struct CompleteCommand* command);
+int execute(struct CompleteCommand* command, bool lastCommand);
 int executeAndRead(struct CompleteCommand* command, struct StringBuffer* sb);
 int executeExpandedCommand(struct ExpandedSimpleCommand* expanded,
         bool subshell, bool useFunctions, const char* path);
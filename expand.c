@@ -21,47 +21,166 @@
 #include <assert.h>
 #include <ctype.h>
 #include <err.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#if defined(__AVX2__)
+#  include <immintrin.h>
+#elif defined(__SSE2__)
+#  include <emmintrin.h>
+#endif
 
+#include "arith.h"
 #include "execute.h"
 #include "expand.h"
 #include "match.h"
 #include "stringbuffer.h"
 #include "variables.h"
-
-static bool doCommandSubstitution(const char** word,
+#include "word.h"
+
+enum {
+    IFS_ORDINARY,
+    IFS_WHITESPACE,
+    IFS_OTHER,
+};
+
+// The IFS value that the tables below were compiled from.
+static char* compiledIfs;
+static unsigned char ifsClass[256];
+static unsigned char ifsChars[4];
+static size_t numIfsChars;
+
+static void addField(char*** fields, size_t* numFields, size_t* allocated,
+        char* field);
+static void compileIfs(const char* ifs);
+static void executeCommandSubstitution(struct CompleteCommand* command,
         struct StringBuffer* sb, struct ExpandContext* context,
-        bool doubleQuoted, bool oldStyle);
-static ssize_t doDollarSubstitutions(const char* word, bool doubleQuoted,
-        struct StringBuffer* sb, struct ExpandContext* context);
-static char* doSubstitutions(const char* word, struct ExpandContext* context);
+        bool doubleQuoted);
+static size_t findIfsChar(const char* word, size_t begin, size_t end);
 static size_t splitFields(char* word, struct ExpandContext* context,
         char*** result);
+static int substituteArithmetic(const struct WordPart* part,
+        struct StringBuffer* sb, struct ExpandContext* context);
+static int substituteParameter(const struct Parameter* param,
+        bool doubleQuoted, struct StringBuffer* sb,
+        struct ExpandContext* context);
+static char* substituteWord(const struct Word* word,
+        struct ExpandContext* context);
+
+char* expandWord2(const struct Word* word, int flags) {
+    if (word->literal) {
+        char* result = strdup(word->text);
+        if (!result) err(1, "strdup");
+        return result;
+    }
 
-char* expandWord2(const char* word, int flags) {
-    char** fields;
-    ssize_t numFields = expand(word, flags | EXPAND_NO_FIELD_SPLIT, &fields);
-    if (numFields < 0) return NULL;
+    char** fields = NULL;
+    size_t numFields = 0;
+    if (!expand(word, flags | EXPAND_NO_FIELD_SPLIT, &fields, &numFields)) {
+        free(fields);
+        return NULL;
+    }
     assert(numFields == 1);
     char* result = fields[0];
     free(fields);
     return result;
 }
 
-char* expandWord(const char* word) {
+char* expandWord(const struct Word* word) {
     return expandWord2(word, 0);
 }
 
-ssize_t expand2(const char* word, int flags, char*** result,
+bool expand(const struct Word* word, int flags, char*** fields,
+        size_t* numFields) {
+    if (word->literal) {
+        // The word expands to itself.
+        char* field = strdup(word->text);
+        if (!field) err(1, "strdup");
+        addToArray((void**) fields, numFields, &field, sizeof(char*));
+        return true;
+    }
+
+    struct ExpandContext context;
+    char** splitFields;
+    ssize_t numSplitFields = expand2(word, flags, &splitFields, &context);
+    if (numSplitFields < 0) return false;
+
+    size_t firstField = *numFields;
+    bool success = true;
+    if (flags & EXPAND_PATHNAMES && !shellOptions.noglob) {
+        success = expandPathnames(splitFields, numSplitFields, fields,
+                numFields, context.substitutions, context.numSubstitutions);
+    } else {
+        size_t substIndex = 0;
+        for (ssize_t i = 0; i < numSplitFields; i++) {
+            // Skip substitutions that ended in earlier fields so that each
+            // field is processed in constant time.
+            while (substIndex < context.numSubstitutions &&
+                    context.substitutions[substIndex].endField < (size_t) i) {
+                substIndex++;
+            }
+            removeQuotes(splitFields[i], i,
+                    context.substitutions + substIndex,
+                    context.numSubstitutions - substIndex,
+                    flags & EXPAND_NO_QUOTES);
+
+            char* field;
+            if (numSplitFields == 1 && splitFields[0] == context.temp) {
+                // The only field can take over the buffer without a copy.
+                field = context.temp;
+                context.temp = NULL;
+            } else {
+                field = strdup(splitFields[i]);
+                if (!field) err(1, "strdup");
+            }
+            addToArray((void**) fields, numFields, &field, sizeof(char*));
+        }
+    }
+    free(splitFields);
+
+    if (success && context.deleteIfEmpty && *numFields == firstField + 1 &&
+            *(*fields)[firstField] == '\0' && context.numSubstitutions == 0) {
+        free((*fields)[firstField]);
+        (*numFields)--;
+    }
+
+    free(context.substitutions);
+    free(context.temp);
+    return success;
+}
+
+static void executeCommandSubstitution(struct CompleteCommand* command,
+        struct StringBuffer* sb, struct ExpandContext* context,
+        bool doubleQuoted) {
+    size_t bufferOffset = sb->used;
+    if (command) {
+        substitutionStatus = executeAndRead(command, sb);
+        // Remove newline characters at the end.
+        while (sb->used > bufferOffset && sb->buffer[sb->used - 1] == '\n') {
+            sb->used--;
+        }
+    }
+
+    struct SubstitutionInfo info;
+    info.begin = bufferOffset;
+    info.end = sb->used;
+    info.startField = 0;
+    info.endField = 0;
+    info.applyFieldSplitting = !doubleQuoted;
+    info.splitAtEnd = false;
+    addToArray((void**) &context->substitutions, &context->numSubstitutions,
+            &info, sizeof(info));
+}
+
+ssize_t expand2(const struct Word* word, int flags, char*** result,
         struct ExpandContext* context) {
     context->substitutions = NULL;
     context->numSubstitutions = 0;
     context->flags = flags;
     context->deleteIfEmpty = false;
 
-    context->temp = doSubstitutions(word, context);
+    context->temp = substituteWord(word, context);
     if (!context->temp) {
         free(context->substitutions);
         return -1;
@@ -82,57 +201,6 @@ ssize_t expand2(const char* word, int flags, char*** result,
     return numFields;
 }
 
-ssize_t expand(const char* word, int flags, char*** result) {
-    struct ExpandContext context;
-    char** fields;
-    ssize_t numFields = expand2(word, flags, &fields, &context);
-    if (numFields < 0) return -1;
-
-    if (flags & EXPAND_PATHNAMES && !shellOptions.noglob) {
-        char** newFields = NULL;
-        size_t numNewFields = 0;
-
-        if (!expandPathnames(fields, numFields, &newFields, &numNewFields,
-                context.substitutions, context.numSubstitutions)) {
-            free(context.substitutions);
-            free(context.temp);
-            return -1;
-        }
-
-        free(fields);
-        fields = newFields;
-        numFields = numNewFields;
-    } else {
-        for (ssize_t i = 0; i < numFields; i++) {
-            fields[i] = removeQuotes(fields[i], i, context.substitutions,
-                    context.numSubstitutions,
-                    flags & EXPAND_NO_QUOTES);
-        }
-    }
-
-    if (context.deleteIfEmpty && numFields == 1 && *fields[0] == '\0' &&
-            context.numSubstitutions == 0) {
-        free(fields[0]);
-        numFields = 0;
-    }
-
-    free(context.substitutions);
-    free(context.temp);
-    *result = fields;
-    return numFields;
-}
-
-static bool isPositionalParameter(const char* s) {
-    do {
-        if (!isdigit(*s)) return false;
-    } while (*++s);
-    return true;
-}
-
-static bool isSpecialParameter(char c) {
-    return strchr("!#$*-?@", c);
-}
-
 static void substitute(const char* value, struct StringBuffer* sb,
         struct ExpandContext* context, bool doubleQuoted, bool splitAtEnd) {
     if (!value) value = "";
@@ -148,15 +216,16 @@ static void substitute(const char* value, struct StringBuffer* sb,
     appendStringToStringBuffer(sb, value);
 }
 
-static void substituteExpansion(const char* word, struct StringBuffer* sb,
-        struct ExpandContext* context, bool doubleQuoted) {
-    char** fields;
+static void substituteExpansion(const struct Word* word,
+        struct StringBuffer* sb, struct ExpandContext* context,
+        bool doubleQuoted) {
+    char** fields = NULL;
+    size_t numFields = 0;
     int flags = context->flags;
     if (doubleQuoted) flags |= EXPAND_NO_FIELD_SPLIT;
-    ssize_t numFields = expand(word, flags, &fields);
-    if (numFields < 0) err(1, "expand");
+    if (!expand(word, flags, &fields, &numFields)) err(1, "expand");
 
-    for (ssize_t i = 0; i < numFields; i++) {
+    for (size_t i = 0; i < numFields; i++) {
         substitute(fields[i], sb, context, true, i < numFields - 1);
         free(fields[i]);
         if (i < numFields - 1) {
@@ -166,260 +235,49 @@ static void substituteExpansion(const char* word, struct StringBuffer* sb,
     free(fields);
 }
 
-static char* readOldCommandSubst(const char** word) {
-    struct StringBuffer sb;
-    initStringBuffer(&sb);
-
-    bool escaped = false;
-    while (**word) {
-        if (**word == '\\') {
-            if (escaped) {
-                appendToStringBuffer(&sb, '\\');
-                escaped = false;
-            } else {
-                escaped = true;
-            }
-        } else if (**word == '`') {
-            if (escaped) {
-                appendToStringBuffer(&sb, '`');
-                escaped = false;
-            } else {
-                (*word)++;
-                return finishStringBuffer(&sb);
-            }
-        } else if (**word == '$') {
-            appendToStringBuffer(&sb, '$');
-            escaped = false;
-        } else {
-            if (escaped) {
-                appendToStringBuffer(&sb, '\\');
-                escaped = false;
-            }
-            appendToStringBuffer(&sb, **word);
-        }
-
-        (*word)++;
-    }
-
-    free(finishStringBuffer(&sb));
-    return NULL;
-}
-
-static bool readInputFromString(const char** str, bool newCommand,
-        void* context) {
-    (void) newCommand;
-
-    const char** word = context;
-    if (!*word) return false;
-    *str = *word;
-    *word = NULL;
-    return true;
-}
-
-static bool doCommandSubstitution(const char** word,
-        struct StringBuffer* sb, struct ExpandContext* context,
-        bool doubleQuoted, bool oldStyle) {
-    struct Parser parser;
-    struct CompleteCommand command;
-    enum ParserResult result;
-
-    if (oldStyle) {
-        char* commandString = readOldCommandSubst(word);
-        if (!commandString) return false;
-        const char* ctx = commandString;
-        initParser(&parser, readInputFromString, &ctx);
-        result = parse(&parser, &command, true);
-        freeParser(&parser);
-        free(commandString);
-    } else {
-        const char* ctx = *word;
-        initParser(&parser, readInputFromString, &ctx);
-        size_t inputRemaining = 0;
-        result = parseCommandSubstitution(&parser, &command, &inputRemaining);
-        freeParser(&parser);
-        *word += strlen(*word) - inputRemaining;
-    }
-
-    if (result != PARSER_MATCH && result != PARSER_NO_CMD) {
-        return false;
-    }
-
-    size_t bufferOffset = sb->used;
-    if (result == PARSER_MATCH) {
-        executeAndRead(&command, sb);
-        // Remove newline characters at the end.
-        while (sb->used > bufferOffset && sb->buffer[sb->used - 1] == '\n') {
-            sb->used--;
+static int substituteArithmetic(const struct WordPart* part,
+        struct StringBuffer* sb, struct ExpandContext* context) {
+    struct Arena arena;
+    initArena(&arena);
+    const struct Arithmetic* arithmetic = part->arithmetic;
+    if (!arithmetic) {
+        // The expression is expanded as if it were in double quotes and
+        // parsed afterwards.
+        struct ExpandContext expressionContext;
+        expressionContext.substitutions = NULL;
+        expressionContext.numSubstitutions = 0;
+        expressionContext.flags = EXPAND_NO_FIELD_SPLIT | EXPAND_NO_QUOTES;
+        expressionContext.deleteIfEmpty = false;
+        char* expression = substituteWord(part->expression,
+                &expressionContext);
+        if (!expression) {
+            free(expressionContext.substitutions);
+            freeArena(&arena);
+            return -2;
         }
-        freeCompleteCommand(&command);
+        removeQuotes(expression, 0, expressionContext.substitutions,
+                expressionContext.numSubstitutions, true);
+        free(expressionContext.substitutions);
+        arithmetic = parseArithmetic(&arena, expression, false);
+        free(expression);
     }
 
-    struct SubstitutionInfo info;
-    info.begin = bufferOffset;
-    info.end = sb->used;
-    info.startField = 0;
-    info.endField = 0;
-    info.applyFieldSplitting = !doubleQuoted;
-    info.splitAtEnd = false;
-    addToArray((void**) &context->substitutions, &context->numSubstitutions,
-            &info, sizeof(info));
+    intmax_t value;
+    bool success = arithmetic && evaluateArithmetic(arithmetic, &value);
+    freeArena(&arena);
+    if (!success) return -2;
 
-    return true;
+    char buffer[sizeof(intmax_t) * 3 + 2];
+    snprintf(buffer, sizeof(buffer), "%" PRIdMAX, value);
+    substitute(buffer, sb, context, part->doubleQuoted, false);
+    return 0;
 }
 
-static ssize_t doDollarSubstitutions(const char* word, bool doubleQuoted,
-        struct StringBuffer* sb, struct ExpandContext* context) {
-    const char* begin = word;
-    char c = *word;
-    if (c == '{') {
-        // TODO: Handle ${@} and ${*}.
-        word++;
-
-        if (word[0] == '}') {
-            return -1;
-        }
-
-        bool varLength = false;
-        if (word[0] == '#') {
-            if (word[1] == '}' || word[1] == ':' || ((word[1] == '-' ||
-                    word[1] == '=' || word[1] == '?' || word[1] == '+') &&
-                    word[2] != '}')) {
-                // The expansion refers to the $# variable.
-            } else {
-                varLength = true;
-                word++;
-            }
-        }
-
-        size_t nameLength = strcspn(word + 1, "#%+-:=?}") + 1;
-        char* name = strndup(word, nameLength);
-        if (!name) err(1, "strdup");
-
-        if (!isRegularVariableName(name) && !isPositionalParameter(name) &&
-                !(nameLength == 1 && isSpecialParameter(*name))) {
-            free(name);
-            return -1;
-        }
-
-        const char* value = getVariable(name);
-        word += nameLength;
-
-        void* toBeFreed = NULL;
-        if (word[0] != '}') {
-            bool nullMeansUnset = word[0] == ':';
-            if (nullMeansUnset) word++;
-
-            c = *word++;
-
-            size_t braces = 0;
-            size_t wordLength;
-            for (wordLength = 0; true; wordLength++) {
-                if (!word[wordLength]) {
-                    free(name);
-                    return -1;
-                }
-                if (word[wordLength] == '$' && word[wordLength + 1] == '{') {
-                    braces++;
-                }
-                if (word[wordLength] == '}') {
-                    if (braces == 0) break;
-                    braces--;
-                }
-            }
-
-            if (c == '-') {
-                if (!value || (nullMeansUnset && !*value)) {
-                    char* subst = strndup(word, wordLength);
-                    if (!subst) err(1, "strdup");
-                    substituteExpansion(subst, sb, context, doubleQuoted);
-                    free(subst);
-                }
-            } else if (c == '=') {
-                if (!value || (nullMeansUnset && !*value)) {
-                    if (!isRegularVariableName(name)) {
-                        free(name);
-                        return -1;
-                    }
-                    char* subst = strndup(word, wordLength);
-                    if (!subst) err(1, "strdup");
-                    value = expandWord(subst);
-                    setVariable(name, value, false);
-                    toBeFreed = (void*) value;
-                    free(subst);
-                }
-            } else if (c == '?') {
-                if (!value || (nullMeansUnset && !*value)) {
-                    char* message = NULL;
-                    if (wordLength) {
-                        char* subst = strndup(word, wordLength);
-                        if (!subst) err(1, "strdup");
-                        message = expandWord(subst);
-                        free(subst);
-                    }
-                    if (message) {
-                        warnx("%s: %s", name, message);
-                        free(message);
-                    } else {
-                        warnx(value ? "%s: parameter is null" :
-                                "%s: parameter is not set", name);
-                    }
-                    if (!shellOptions.interactive) exit(1);
-                    free(name);
-                    return -2;
-                }
-            } else if (c == '+') {
-                if (value && (!nullMeansUnset || *value)) {
-                    char* subst = strndup(word, wordLength);
-                    if (!subst) err(1, "strdup");
-                    substituteExpansion(subst, sb, context, doubleQuoted);
-                    free(subst);
-                    value = NULL;
-                }
-            } else if (c == '%' || c == '#') {
-                if (nullMeansUnset) {
-                    return -1;
-                }
-
-                bool prefix = c == '#';
-                bool greedy = *word == c;
-                if (greedy) {
-                    word++;
-                    wordLength--;
-                }
-                char* pattern = strndup(word, wordLength);
-                if (!pattern) err(1, "malloc");
-
-                size_t stripLength = stripPrefixSuffix(value, pattern, prefix,
-                        greedy);
-                free(pattern);
-
-                size_t stripPrefix = prefix ? stripLength : 0;
-                char* strippedValue = strndup(value + stripPrefix,
-                        strlen(value) - stripLength);
-                if (!strippedValue) err(1, "malloc");
-                toBeFreed = strippedValue;
-                value = strippedValue;
-            }
-            word += wordLength;
-        }
-
-        word++;
-        free(name);
-        char buffer[21];
-
-        if (varLength) {
-            snprintf(buffer, sizeof(buffer), "%zu",
-                    value ? strlen(value) : (size_t) 0);
-            value = buffer;
-        }
-        substitute(value, sb, context, doubleQuoted, false);
-        free(toBeFreed);
-    } else if (c == '(') {
-        word++;
-        if (!doCommandSubstitution(&word, sb, context, doubleQuoted, false)) {
-            return -1;
-        }
-    } else if (c == '*' || c == '@') {
+static int substituteParameter(const struct Parameter* param,
+        bool doubleQuoted, struct StringBuffer* sb,
+        struct ExpandContext* context) {
+    if (param->allArguments) {
+        char c = param->name[0];
         bool splitting = !doubleQuoted &&
                 !(context->flags & EXPAND_NO_FIELD_SPLIT);
         const char* ifs = getVariable("IFS");
@@ -436,86 +294,203 @@ static ssize_t doDollarSubstitutions(const char* word, bool doubleQuoted,
                 appendToStringBuffer(sb, sep);
             }
         }
-        word++;
-    } else if (isdigit(c) || isSpecialParameter(c)) {
-        char name[2] = { c, '\0' };
-        const char* value = getVariable(name);
-        substitute(value, sb, context, doubleQuoted, false);
-        word++;
-    } else if (isalpha(c) || c == '_') {
-        size_t nameLength = 1;
-        while (isalnum(word[nameLength]) || word[nameLength] == '_') {
-            nameLength++;
+        return 0;
+    }
+
+    const char* value = getVariable(param->name);
+    bool isNull = !value || (param->nullMeansUnset && !*value);
+    void* toBeFreed = NULL;
+
+    if (param->op == '-') {
+        if (isNull) {
+            substituteExpansion(param->argument, sb, context, doubleQuoted);
         }
-        char* name = strndup(word, nameLength);
-        if (!name) err(1, "strdup");
-        const char* value = getVariable(name);
-        free(name);
-        substitute(value, sb, context, doubleQuoted, false);
-        word += nameLength;
-    } else {
-        appendToStringBuffer(sb, '$');
+    } else if (param->op == '=') {
+        if (isNull) {
+            if (!isRegularVariableName(param->name)) return -1;
+            value = expandWord(param->argument);
+            setVariable(param->name, value, false);
+            toBeFreed = (void*) value;
+        }
+    } else if (param->op == '?') {
+        if (isNull) {
+            char* message = NULL;
+            if (*param->argument->text) {
+                message = expandWord(param->argument);
+            }
+            if (message) {
+                warnx("%s: %s", param->name, message);
+                free(message);
+            } else {
+                warnx(value ? "%s: parameter is null" :
+                        "%s: parameter is not set", param->name);
+            }
+            if (!shellOptions.interactive) exit(1);
+            return -2;
+        }
+    } else if (param->op == '+') {
+        if (!isNull) {
+            substituteExpansion(param->argument, sb, context, doubleQuoted);
+            value = NULL;
+        }
+    } else if ((param->op == '%' || param->op == '#') && value) {
+        bool prefix = param->op == '#';
+        size_t stripLength = stripPrefixSuffix(value, param->argument, prefix,
+                param->greedy);
+
+        size_t stripPrefix = prefix ? stripLength : 0;
+        char* strippedValue = strndup(value + stripPrefix,
+                strlen(value) - stripLength);
+        if (!strippedValue) err(1, "malloc");
+        toBeFreed = strippedValue;
+        value = strippedValue;
     }
 
-    return word - begin;
+    char buffer[21];
+    if (param->length) {
+        snprintf(buffer, sizeof(buffer), "%zu",
+                value ? strlen(value) : (size_t) 0);
+        value = buffer;
+    }
+    substitute(value, sb, context, doubleQuoted, false);
+    free(toBeFreed);
+    return 0;
 }
 
-static char* doSubstitutions(const char* word, struct ExpandContext* context) {
+static char* substituteWord(const struct Word* word,
+        struct ExpandContext* context) {
     struct StringBuffer sb;
     initStringBuffer(&sb);
 
-    bool noQuotes = context->flags & EXPAND_NO_QUOTES;
-    bool escaped = false;
-    bool singleQuote = false;
-    bool doubleQuote = false;
-
-    while (*word) {
-        char c = *word++;
-
-        if (!singleQuote && c == '\\') {
-            escaped = !escaped;
-        } else if (!escaped && !noQuotes && !doubleQuote && c == '\'') {
-            singleQuote = !singleQuote;
-        } else if (!escaped && !noQuotes && !singleQuote && c == '"') {
-            doubleQuote = !doubleQuote;
-        } else if (!escaped && !singleQuote && c == '$') {
-            ssize_t length = doDollarSubstitutions(word, doubleQuote, &sb,
-                    context);
-            if (length < 0) {
-                free(sb.buffer);
-                if (length == -1) warnx("invalid substitution");
-                return NULL;
-            }
-            word += length;
-            continue;
-        } else if (!escaped && !singleQuote && c == '`') {
-            if (!doCommandSubstitution(&word, &sb, context, doubleQuote,
-                    true)) {
-                free(sb.buffer);
-                warnx("invalid substitution");
-                return NULL;
-            }
-            continue;
+    for (size_t i = 0; i < word->numParts; i++) {
+        const struct WordPart* part = &word->parts[i];
+        int result = 0;
+
+        switch (part->type) {
+        case WORDPART_TEXT:
+            appendBytesToStringBuffer(&sb, part->text, part->length);
+            break;
+        case WORDPART_PARAMETER:
+            result = substituteParameter(part->parameter, part->doubleQuoted,
+                    &sb, context);
+            break;
+        case WORDPART_COMMAND:
+            executeCommandSubstitution(part->command, &sb, context,
+                    part->doubleQuoted);
+            break;
+        case WORDPART_ARITHMETIC:
+            result = substituteArithmetic(part, &sb, context);
+            break;
+        case WORDPART_INVALID:
+            reportInvalidCommand(part);
+            result = -1;
+            break;
         }
 
-        appendToStringBuffer(&sb, c);
-        escaped = escaped && c == '\\';
+        if (result < 0) {
+            freeStringBuffer(&sb);
+            if (result == -1) warnx("invalid substitution");
+            return NULL;
+        }
     }
 
     return finishStringBuffer(&sb);
 }
 
-static bool isIfsWhiteSpace(char c) {
-    return c == ' ' || c == '\t' || c == '\n';
+static void addField(char*** fields, size_t* numFields, size_t* allocated,
+        char* field) {
+    if (*numFields == *allocated) {
+        size_t newSize = *allocated ? 2 * *allocated : 16;
+        char** newFields = reallocarray(*fields, newSize, sizeof(char*));
+        if (!newFields) err(1, "realloc");
+        *fields = newFields;
+        *allocated = newSize;
+    }
+    (*fields)[(*numFields)++] = field;
+}
+
+static void compileIfs(const char* ifs) {
+    if (compiledIfs && strcmp(ifs, compiledIfs) == 0) return;
+
+    free(compiledIfs);
+    compiledIfs = strdup(ifs);
+    if (!compiledIfs) err(1, "strdup");
+
+    memset(ifsClass, IFS_ORDINARY, sizeof(ifsClass));
+    numIfsChars = 0;
+    for (const char* c = ifs; *c; c++) {
+        unsigned char byte = *c;
+        if (ifsClass[byte] != IFS_ORDINARY) continue;
+
+        if (byte == ' ' || byte == '\t' || byte == '\n') {
+            ifsClass[byte] = IFS_WHITESPACE;
+        } else {
+            ifsClass[byte] = IFS_OTHER;
+        }
+
+        if (numIfsChars < sizeof(ifsChars)) {
+            ifsChars[numIfsChars] = byte;
+        }
+        numIfsChars++;
+    }
+}
+
+// Returns the index of the first IFS character in word[begin, end) or end if
+// there is none.
+static size_t findIfsChar(const char* word, size_t begin, size_t end) {
+    size_t i = begin;
+    if (numIfsChars == 0) return end;
+
+#if defined(__AVX2__) || defined(__SSE2__)
+    // Compare 32 or 16 bytes at a time against each IFS character. This is
+    // only done for the usual short IFS values.
+    if (numIfsChars <= sizeof(ifsChars)) {
+#ifdef __AVX2__
+        __m256i chars256[sizeof(ifsChars)];
+        for (size_t j = 0; j < numIfsChars; j++) {
+            chars256[j] = _mm256_set1_epi8(ifsChars[j]);
+        }
+        for (; i + 32 <= end; i += 32) {
+            __m256i data = _mm256_loadu_si256((const __m256i*) (word + i));
+            __m256i matches = _mm256_setzero_si256();
+            for (size_t j = 0; j < numIfsChars; j++) {
+                matches = _mm256_or_si256(matches,
+                        _mm256_cmpeq_epi8(data, chars256[j]));
+            }
+            unsigned int mask = _mm256_movemask_epi8(matches);
+            if (mask) return i + __builtin_ctz(mask);
+        }
+#endif
+        __m128i chars[sizeof(ifsChars)];
+        for (size_t j = 0; j < numIfsChars; j++) {
+            chars[j] = _mm_set1_epi8(ifsChars[j]);
+        }
+        for (; i + 16 <= end; i += 16) {
+            __m128i data = _mm_loadu_si128((const __m128i*) (word + i));
+            __m128i matches = _mm_setzero_si128();
+            for (size_t j = 0; j < numIfsChars; j++) {
+                matches = _mm_or_si128(matches, _mm_cmpeq_epi8(data, chars[j]));
+            }
+            unsigned int mask = _mm_movemask_epi8(matches);
+            if (mask) return i + __builtin_ctz(mask);
+        }
+    }
+#endif
+
+    for (; i < end; i++) {
+        if (ifsClass[(unsigned char) word[i]] != IFS_ORDINARY) return i;
+    }
+    return end;
 }
 
 static size_t splitFields(char* word, struct ExpandContext* context,
         char*** result) {
     const char* ifs = getVariable("IFS");
-    if (!ifs) ifs = " \t\n";
+    compileIfs(ifs ? ifs : " \t\n");
 
     char** fields = NULL;
     size_t numFields = 0;
+    size_t fieldsAllocated = 0;
     size_t fieldOffset = 0;
     size_t wordLength = strlen(word);
 
@@ -528,56 +503,53 @@ static size_t splitFields(char* word, struct ExpandContext* context,
 
         size_t splitBegin = subst->begin;
         while (subst->applyFieldSplitting && fieldOffset < subst->end) {
-            size_t length = splitBegin + strcspn(word + fieldOffset +
-                    splitBegin, ifs);
+            size_t delimiter = findIfsChar(word, fieldOffset + splitBegin,
+                    subst->end);
             splitBegin = 0;
 
-            if (fieldOffset + length >= subst->end) break;
-            if (fieldOffset + length != 0 || !isIfsWhiteSpace(word[0])) {
-                char* field = word + fieldOffset;
-                addToArray((void**) &fields, &numFields, &field, sizeof(char*));
-            }
-
-            fieldOffset += length;
-            bool nonWhitespace = !isIfsWhiteSpace(word[fieldOffset]);
-            bool emptyInput = fieldOffset == 0;
-
-            word[fieldOffset++] = '\0';
-
-            length = strspn(word + fieldOffset, ifs);
-            if (fieldOffset + length > subst->end) {
-                length = subst->end - fieldOffset;
+            if (delimiter >= subst->end) break;
+            if (delimiter != 0 ||
+                    ifsClass[(unsigned char) word[0]] != IFS_WHITESPACE) {
+                addField(&fields, &numFields, &fieldsAllocated,
+                        word + fieldOffset);
             }
 
-            for (size_t j = 0; j < length; j++) {
-                if (!isIfsWhiteSpace(word[fieldOffset + j])) {
+            bool nonWhitespace =
+                    ifsClass[(unsigned char) word[delimiter]] == IFS_OTHER;
+            bool emptyInput = delimiter == 0;
+            word[delimiter] = '\0';
+            fieldOffset = delimiter + 1;
+
+            // Skip the remaining IFS characters of this delimiter. Each
+            // further non-whitespace IFS character delimits an empty field.
+            while (fieldOffset < subst->end) {
+                unsigned char byte = word[fieldOffset];
+                unsigned char class = ifsClass[byte];
+                if (class == IFS_ORDINARY) break;
+                if (class == IFS_OTHER) {
                     if (nonWhitespace || emptyInput) {
-                        word[fieldOffset + j] = '\0';
-                        char* field = word + fieldOffset + j;
-                        addToArray((void**) &fields, &numFields, &field,
-                                sizeof(char*));
+                        word[fieldOffset] = '\0';
+                        addField(&fields, &numFields, &fieldsAllocated,
+                                word + fieldOffset);
                     }
                     nonWhitespace = true;
                 }
+                fieldOffset++;
             }
-
-            fieldOffset += length;
         }
 
         subst->endField = numFields;
         subst->end -= fieldOffset;
 
         if (subst->splitAtEnd) {
-            char* field = word + fieldOffset;
-            addToArray((void**) &fields, &numFields, &field, sizeof(char*));
+            addField(&fields, &numFields, &fieldsAllocated, word + fieldOffset);
             fieldOffset += subst->end;
             word[fieldOffset++] = '\0';
         }
     }
 
     if (fieldOffset != wordLength) {
-        char* field = word + fieldOffset;
-        addToArray((void**) &fields, &numFields, &field, sizeof(char*));
+        addField(&fields, &numFields, &fieldsAllocated, word + fieldOffset);
     }
 
     *result = fields;
@@ -588,20 +560,23 @@ static bool isSpecialInDoubleQuotes(char c, bool backslashOnly) {
     return c == '$' || c == '`' || c == '\\' || (!backslashOnly && c == '"');
 }
 
-char* removeQuotes(const char* word, size_t fieldIndex,
+void removeQuotes(char* word, size_t fieldIndex,
         struct SubstitutionInfo* substitutions, size_t numSubstitutions,
         bool backslashOnly) {
+    // Quotes are removed in place. Nothing before the first quoting character
+    // needs to be moved.
+    char* quote = strpbrk(word, backslashOnly ? "\\" : "\\'\"");
+    if (!quote) return;
+
     size_t substIndex = 0;
-    struct SubstitutionInfo* subst = substitutions;
+    struct SubstitutionInfo* subst = numSubstitutions ? substitutions : NULL;
 
     bool escaped = false;
     bool singleQuote = false;
     bool doubleQuote = backslashOnly;
 
-    struct StringBuffer buffer;
-    initStringBuffer(&buffer);
-
-    for (size_t i = 0; word[i]; i++) {
+    size_t length = quote - word;
+    for (size_t i = length; word[i]; i++) {
         while (subst && !(fieldIndex < subst->endField ||
                 (fieldIndex == subst->endField && i < subst->end))) {
             substIndex++;
@@ -630,7 +605,7 @@ char* removeQuotes(const char* word, size_t fieldIndex,
         }
 
         escaped = false;
-        appendToStringBuffer(&buffer, c);
+        word[length++] = c;
     }
-    return finishStringBuffer(&buffer);
+    word[length] = '\0';
 }
@@ -1,4 +1,4 @@
-/* Copyright (c) 2018, 2019, 2020, 2021, 2022, 2025 Dennis Wölfing
+/* Copyright (c) 2018, 2019, 2020, 2021, 2022, 2025, 2026 Dennis Wölfing
  *
  * Permission to use, copy, modify, and/or distribute this software for any
  * purpose with or without fee is hereby granted, provided that the above
@@ -22,6 +22,8 @@
 
 #include "dxsh.h"
 
+struct Word;
+
 struct SubstitutionInfo {
     size_t begin;
     size_t end;
@@ -45,12 +47,13 @@ enum {
     EXPAND_NO_QUOTES = 1 << 2,
 };
 
-NO_DISCARD ssize_t expand(const char* word, int flags, char*** result);
-NO_DISCARD ssize_t expand2(const char* word, int flags, char*** result,
+NO_DISCARD bool expand(const struct Word* word, int flags, char*** fields,
+        size_t* numFields);
+NO_DISCARD ssize_t expand2(const struct Word* word, int flags, char*** result,
         struct ExpandContext* context);
-char* expandWord(const char* word);
-char* expandWord2(const char* word, int flags);
-char* removeQuotes(const char* word, size_t fieldIndex,
+char* expandWord(const struct Word* word);
+char* expandWord2(const struct Word* word, int flags);
+void removeQuotes(char* word, size_t fieldIndex,
         struct SubstitutionInfo* substitutions, size_t numSubstitutions,
         bool backslashOnly);
 
@@ -1,4 +1,4 @@
-/* Copyright (c) 2020, 2021, 2022, 2025 Dennis Wölfing
+/* Copyright (c) 2020, 2021, 2022, 2025, 2026 Dennis Wölfing
  *
  * Permission to use, copy, modify, and/or distribute this software for any
  * purpose with or without fee is hereby granted, provided that the above
@@ -93,7 +93,8 @@ void initializeInteractive(void) {
     historySize = 0;
 }
 
-bool readCommandInteractive(const char** str, bool newCommand, void* context) {
+bool readCommandInteractive(const char** str, size_t* length, bool newCommand,
+        void* context) {
     (void) context;
 
     struct HistoryEntry newEntry;
@@ -261,9 +262,11 @@ bool readCommandInteractive(const char** str, bool newCommand, void* context) {
             return false;
         }
         *str = "\n";
+        *length = 1;
         free(newEntry.buffer);
     } else {
         *str = entry->buffer;
+        *length = strlen(entry->buffer);
         if (entry != &newEntry) {
             free(newEntry.buffer);
         }
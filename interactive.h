@@ -1,4 +1,4 @@
-/* Copyright (c) 2020, 2022 Dennis Wölfing
+/* Copyright (c) 2020, 2022, 2026 Dennis Wölfing
  *
  * Permission to use, copy, modify, and/or distribute this software for any
  * purpose with or without fee is hereby granted, provided that the above
@@ -25,6 +25,7 @@
 
 void freeInteractive(void);
 void initializeInteractive(void);
-bool readCommandInteractive(const char** str, bool newCommand, void* context);
+bool readCommandInteractive(const char** str, size_t* length, bool newCommand,
+        void* context);
 
 #endif
@@ -18,14 +18,210 @@
  */
 
 #include <config.h>
+#include <ctype.h>
+#include <dirent.h>
 #include <err.h>
+#include <fcntl.h>
 #include <fnmatch.h>
-#include <glob.h>
+#if HAVE_PTHREAD
+#  include <pthread.h>
+#  include <signal.h>
+#endif
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include "expand.h"
 #include "match.h"
 #include "stringbuffer.h"
+#include "variables.h"
+#include "word.h"
+
+// A pattern compiled to a nondeterministic automaton that is simulated with
+// one bit per state. State i means that the first i elements of the pattern
+// have been matched. Consecutive asterisks are collapsed into one.
+struct Automaton {
+    size_t numStates;
+    size_t numWords;
+    // The states whose element is an asterisk.
+    uint64_t* stars;
+    // For each byte the states whose element matches that byte.
+    uint64_t* transitions;
+};
+
+struct PatternElement {
+    bool star;
+    uint64_t set[256 / 64];
+};
+
+struct CompiledPattern {
+    struct Automaton forward;
+    // The automaton of the reversed pattern, used to match suffixes. It is
+    // only built when it is first needed.
+    struct Automaton reverse;
+    struct PatternElement* elements;
+    size_t numElements;
+};
+
+struct CasePattern {
+    const struct Word* word;
+    size_t item;
+    // Patterns without substitutions are expanded only once. If the result
+    // cannot be compiled the prepared pattern is passed to fnmatch instead.
+    bool expanded;
+    struct CompiledPattern* compiled;
+    char* prepared;
+};
+
+struct CasePatterns {
+    struct CasePattern* patterns;
+    size_t numPatterns;
+    // Indices of the patterns that are not literal, in order.
+    size_t* ordered;
+    size_t numOrdered;
+    // Open addressing hash table of literal patterns. Each slot contains one
+    // plus the index of the first literal pattern with that text, or 0.
+    size_t* literals;
+    size_t literalsMask;
+};
+
+struct CachedPattern {
+    char* text;
+    // The text is the pattern before expansion and quote removal.
+    bool raw;
+    // NULL if the pattern cannot be compiled.
+    struct CompiledPattern* pattern;
+};
+
+// The entries of a directory as read by readdir.
+struct DirectoryListing {
+    dev_t device;
+    ino_t inode;
+    struct timespec modified;
+    struct timespec changed;
+    char* names;
+    size_t* offsets;
+    unsigned char* types;
+    size_t numNames;
+    unsigned long lastUse;
+    // Listings that are being iterated are not freed.
+    size_t users;
+    bool cached;
+};
+
+struct GlobComponent {
+    // The number of slashes before the component.
+    size_t slashes;
+    // The name of literal components, or the pattern otherwise.
+    char* text;
+    bool literal;
+    // A ** component that matches any number of directories.
+    bool globstar;
+    // NULL if the pattern cannot be compiled.
+    struct CompiledPattern* compiled;
+};
+
+struct Glob {
+    struct GlobComponent* components;
+    size_t numComponents;
+    struct StringBuffer path;
+    char*** pathnames;
+    size_t* numPathnames;
+    // The number of threads that read sibling directories concurrently.
+    size_t workers;
+};
+
+// A directory that is being read by a recursive walk.
+struct WalkDirectory {
+    DIR* dir;
+    dev_t device;
+    ino_t inode;
+    // The length of the path including the trailing slash.
+    size_t pathLength;
+};
+
+#define MAX_GLOB_WORKERS 64
+
+#if HAVE_PTHREAD
+// Subdirectories that are distributed among the worker threads.
+struct GlobWork {
+    const struct Glob* glob;
+    int dirFd;
+    size_t index;
+    // The path of the parent directory.
+    const char* prefix;
+    size_t prefixLength;
+    char** names;
+    size_t numNames;
+    size_t next;
+    pthread_mutex_t mutex;
+};
+#endif
+
+#define PATTERN_CACHE_SIZE 64
+static struct CachedPattern patternCache[PATTERN_CACHE_SIZE];
+
+struct DirectoryCache directoryCache = { .maxEntries = 32 };
+static struct DirectoryListing** listings;
+#if HAVE_PTHREAD
+// Protects the directory cache while worker threads are running.
+static pthread_mutex_t listingsMutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+static void buildAutomaton(struct Automaton* automaton,
+        const struct PatternElement* elements, size_t numElements,
+        bool reverse);
+static int compareStrings(const void* a, const void* b);
+static struct CompiledPattern* compilePattern(const char* pattern);
+static void evictDirectoryListing(size_t index);
+static char* expandPattern(const struct Word* pattern);
+static struct CachedPattern* findCachedPattern(const char* text, bool raw);
+static void freeCompiledPattern(struct CompiledPattern* pattern);
+static size_t hashString(const char* text);
+static struct CompiledPattern* getCompiledPattern(const struct Word* pattern,
+        char** prepared);
+static struct DirectoryListing* getDirectoryListing(int fd);
+static void globDirectory(struct Glob* glob, int dirFd, size_t relative,
+        size_t index);
+static size_t getGlobWorkers(void);
+static void globInParallel(struct Glob* glob, int dirFd, size_t relative,
+        size_t index, char** names, size_t numNames);
+static void globPathnames(char* pattern, char*** pathnames,
+        size_t* numPathnames);
+static void globRecursively(struct Glob* glob, int dirFd, size_t relative,
+        size_t index);
+static void lockDirectoryCache(void);
+static size_t matchAutomaton(const struct Automaton* automaton,
+        const char* word, size_t length, bool reverse, bool greedy,
+        bool* matched);
+static bool matchesCompiledPattern(const struct CompiledPattern* pattern,
+        const char* word);
+static bool matchesGlobComponent(const struct GlobComponent* component,
+        const char* name);
+static bool parseBracketChar(const char** p, unsigned char* c);
+static const char* parseBracketExpression(const char* p, uint64_t* set);
+static void releaseCasePatterns(void* patterns);
+static void releaseDirectoryListing(struct DirectoryListing* listing);
+static void removeDuplicates(char** pathnames, size_t* numPathnames,
+        size_t first);
+static void unlockDirectoryCache(void);
+#if HAVE_PTHREAD
+static void globWithThreads(struct Glob* glob, int dirFd, size_t relative,
+        size_t index, char** names, size_t numNames);
+static void* globWorker(void* arg);
+#endif
+
+// Adds a field that is not expanded to pathnames after removing quotes.
+static void addPathname(char*** pathnames, size_t* numPathnames, char* field,
+        size_t fieldIndex, struct SubstitutionInfo* subst,
+        size_t numSubstitutions) {
+    removeQuotes(field, fieldIndex, subst, numSubstitutions, false);
+    char* str = strdup(field);
+    if (!str) err(1, "strdup");
+    addToArray((void**) pathnames, numPathnames, &str, sizeof(char*));
+}
 
 static bool isSpecialCharInBracketExpressions(char c) {
     return c == '[' || c == ']' || c == '!' || c == '^' || c == '-';
@@ -112,7 +308,7 @@ static size_t prepareBracketExpression(const char* pattern, size_t fieldIndex,
     bool literal = nextChar(&context, &c);
     while (c != '\0') {
         if (pathname && c == '/') {
-            free(finishStringBuffer(&expr));
+            freeStringBuffer(&expr);
             return 0;
         } else if (literal && isSpecialCharInBracketExpressions(c)) {
             // We use collating symbols to force a character to be taken
@@ -171,13 +367,12 @@ static size_t prepareBracketExpression(const char* pattern, size_t fieldIndex,
     }
 
     if (c != ']') {
-        free(finishStringBuffer(&expr));
+        freeStringBuffer(&expr);
         return 0;
     }
     appendToStringBuffer(&expr, ']');
-    char* str = finishStringBuffer(&expr);
-    appendStringToStringBuffer(buffer, str);
-    free(str);
+    appendBytesToStringBuffer(buffer, expr.buffer, expr.used);
+    freeStringBuffer(&expr);
     return context.i - expressionBegin;
 }
 
@@ -230,58 +425,173 @@ static char* preparePattern(const char* pattern, size_t fieldIndex,
     return finishStringBuffer(&buffer);
 }
 
-bool matchesPattern(const char* expandedWord, const char* pattern) {
-    struct ExpandContext context;
-    char** fields;
-    ssize_t numFields = expand2(pattern, EXPAND_NO_FIELD_SPLIT, &fields,
-            &context);
-    if (numFields < 0) return false;
+struct CasePatterns* createCasePatterns(struct Arena* arena,
+        const struct CaseClause* clause) {
+    struct CasePatterns* result = arenaAllocate(arena,
+            sizeof(struct CasePatterns));
+    result->patterns = NULL;
+    result->numPatterns = 0;
+    result->ordered = NULL;
+    result->numOrdered = 0;
+    result->literals = NULL;
+    result->literalsMask = 0;
 
-    bool containsSpecial;
-    char* prepared = preparePattern(fields[0], 0, context.substitutions,
-            context.numSubstitutions, false, &containsSpecial);
+    size_t numLiterals = 0;
+    for (size_t i = 0; i < clause->numItems; i++) {
+        const struct CaseItem* item = &clause->items[i];
+        for (size_t j = 0; j < item->numPatterns; j++) {
+            struct CasePattern pattern;
+            pattern.word = item->patterns[j];
+            pattern.item = i;
+            pattern.expanded = false;
+            pattern.compiled = NULL;
+            pattern.prepared = NULL;
+            size_t index = result->numPatterns;
+            arenaAddToArray(arena, (void**) &result->patterns,
+                    &result->numPatterns, &pattern, sizeof(pattern));
+
+            if (pattern.word->literal) {
+                numLiterals++;
+            } else {
+                arenaAddToArray(arena, (void**) &result->ordered,
+                        &result->numOrdered, &index, sizeof(size_t));
+            }
+        }
+    }
+
+    if (numLiterals > 0) {
+        size_t size = 8;
+        while (size < 2 * numLiterals) {
+            size *= 2;
+        }
+        result->literals = arenaAllocate(arena, size * sizeof(size_t));
+        memset(result->literals, 0, size * sizeof(size_t));
+        result->literalsMask = size - 1;
+
+        for (size_t i = 0; i < result->numPatterns; i++) {
+            const struct Word* word = result->patterns[i].word;
+            if (!word->literal) continue;
+            size_t slot = hashString(word->text) & result->literalsMask;
+            while (result->literals[slot] != 0 && strcmp(word->text,
+                    result->patterns[result->literals[slot] - 1].word->text)
+                    != 0) {
+                slot = (slot + 1) & result->literalsMask;
+            }
+            // Only the first occurrence of a pattern can ever match.
+            if (result->literals[slot] == 0) {
+                result->literals[slot] = i + 1;
+            }
+        }
+    }
+
+    arenaDefer(arena, releaseCasePatterns, result);
+    return result;
+}
+
+size_t findCaseItem(struct CasePatterns* patterns, const char* word) {
+    // The first literal pattern equal to the word is found directly. Only
+    // the other patterns before it need to be checked in order.
+    size_t end = patterns->numPatterns;
+    if (patterns->literals) {
+        size_t slot = hashString(word) & patterns->literalsMask;
+        while (patterns->literals[slot] != 0) {
+            size_t index = patterns->literals[slot] - 1;
+            if (strcmp(word, patterns->patterns[index].word->text) == 0) {
+                end = index;
+                break;
+            }
+            slot = (slot + 1) & patterns->literalsMask;
+        }
+    }
+
+    for (size_t i = 0; i < patterns->numOrdered; i++) {
+        if (patterns->ordered[i] > end) break;
+        struct CasePattern* pattern =
+                &patterns->patterns[patterns->ordered[i]];
+
+        bool matched;
+        if (strpbrk(pattern->word->text, "$`")) {
+            matched = matchesPattern(word, pattern->word);
+        } else {
+            if (!pattern->expanded) {
+                pattern->prepared = expandPattern(pattern->word);
+                if (pattern->prepared) {
+                    pattern->compiled = compilePattern(pattern->prepared);
+                }
+                if (pattern->compiled) {
+                    free(pattern->prepared);
+                    pattern->prepared = NULL;
+                }
+                pattern->expanded = true;
+            }
+
+            if (pattern->compiled) {
+                matched = matchesCompiledPattern(pattern->compiled, word);
+            } else {
+                matched = pattern->prepared &&
+                        fnmatch(pattern->prepared, word, 0) == 0;
+            }
+        }
+        if (matched) return pattern->item;
+    }
+
+    if (end < patterns->numPatterns) {
+        return patterns->patterns[end].item;
+    }
+    return SIZE_MAX;
+}
+
+bool matchesPattern(const char* expandedWord, const struct Word* pattern) {
+    char* prepared;
+    struct CompiledPattern* compiled = getCompiledPattern(pattern, &prepared);
+    if (compiled) return matchesCompiledPattern(compiled, expandedWord);
+    if (!prepared) return false;
 
     bool result = fnmatch(prepared, expandedWord, 0) == 0;
     free(prepared);
-    free(context.substitutions);
-    free(context.temp);
-    free(fields);
     return result;
 }
 
+void clearDirectoryCache(void) {
+    size_t maxEntries = directoryCache.maxEntries;
+    resizeDirectoryCache(0);
+    directoryCache.maxEntries = maxEntries;
+}
+
 bool expandPathnames(char** fields, size_t numFields, char*** pathnames,
         size_t* numPathnames, struct SubstitutionInfo* subst,
         size_t numSubstitutions) {
     for (size_t i = 0; i < numFields; i++) {
+        // Skip substitutions that ended in earlier fields.
+        while (numSubstitutions > 0 && subst->endField < i) {
+            subst++;
+            numSubstitutions--;
+        }
+
+        if (!strpbrk(fields[i], "*?[")) {
+            // Fields without any special characters cannot match pathnames.
+            addPathname(pathnames, numPathnames, fields[i], i, subst,
+                    numSubstitutions);
+            continue;
+        }
+
         bool containsSpecial;
         char* pattern = preparePattern(fields[i], i, subst, numSubstitutions,
                 true, &containsSpecial);
         if (containsSpecial) {
-            glob_t data;
-            int result = glob(pattern, 0, NULL, &data);
-
-            if (result == 0) {
-                for (size_t j = 0; j < data.gl_pathc; j++) {
-                    char* str = strdup(data.gl_pathv[j]);
-                    if (!str) err(1, "malloc");
-                    addToArray((void**) pathnames, numPathnames, &str,
-                            sizeof(char*));
-                }
-            } else if (result == GLOB_NOMATCH) {
-                char* str = removeQuotes(fields[i], i, subst, numSubstitutions,
-                        false);
-                addToArray((void**) pathnames, numPathnames, &str,
-                        sizeof(char*));
+            size_t first = *numPathnames;
+            globPathnames(pattern, pathnames, numPathnames);
+            if (*numPathnames == first) {
+                addPathname(pathnames, numPathnames, fields[i], i, subst,
+                        numSubstitutions);
             } else {
-                warnx("pathname expansion error");
-                globfree(&data);
-                return false;
+                qsort(*pathnames + first, *numPathnames - first,
+                        sizeof(char*), compareStrings);
+                removeDuplicates(*pathnames + first, numPathnames, first);
             }
-            globfree(&data);
         } else {
-            char* str = removeQuotes(fields[i], i, subst, numSubstitutions,
-                    false);
-            addToArray((void**) pathnames, numPathnames, &str, sizeof(char*));
+            addPathname(pathnames, numPathnames, fields[i], i, subst,
+                    numSubstitutions);
         }
         free(pattern);
     }
@@ -289,26 +599,46 @@ bool expandPathnames(char** fields, size_t numFields, char*** pathnames,
     return true;
 }
 
-size_t stripPrefixSuffix(const char* word, const char* pattern, bool isPrefix,
-        bool greedy) {
-    struct ExpandContext context;
-    char** fields;
-    ssize_t numFields = expand2(pattern, EXPAND_NO_FIELD_SPLIT, &fields,
-            &context);
-    if (numFields < 0) return false;
+void resizeDirectoryCache(size_t maxEntries) {
+    directoryCache.maxEntries = maxEntries;
+    while (directoryCache.numEntries > maxEntries) {
+        size_t leastRecentlyUsed = 0;
+        for (size_t i = 1; i < directoryCache.numEntries; i++) {
+            if (listings[i]->lastUse < listings[leastRecentlyUsed]->lastUse) {
+                leastRecentlyUsed = i;
+            }
+        }
+        evictDirectoryListing(leastRecentlyUsed);
+        directoryCache.evictions++;
+    }
+    if (directoryCache.numEntries == 0) {
+        free(listings);
+        listings = NULL;
+    }
+}
 
-    bool containsSpecial;
-    char* prepared = preparePattern(fields[0], 0, context.substitutions,
-            context.numSubstitutions, false, &containsSpecial);
-    free(context.substitutions);
-    free(context.temp);
-    free(fields);
+size_t stripPrefixSuffix(const char* word, const struct Word* pattern,
+        bool isPrefix, bool greedy) {
+    char* prepared;
+    struct CompiledPattern* compiled = getCompiledPattern(pattern, &prepared);
+    if (!compiled && !prepared) return 0;
+
+    size_t wordLength = strlen(word);
+    if (compiled) {
+        if (!isPrefix && !compiled->reverse.transitions) {
+            buildAutomaton(&compiled->reverse, compiled->elements,
+                    compiled->numElements, true);
+        }
+        bool matched;
+        size_t length = matchAutomaton(isPrefix ? &compiled->forward :
+                &compiled->reverse, word, wordLength, !isPrefix, greedy,
+                &matched);
+        return matched ? length : 0;
+    }
 
     char* dupWord = strdup(word);
     if (!dupWord) err(1, "malloc");
 
-    size_t wordLength = strlen(word);
-
     size_t start;
     size_t end;
     bool countUp;
@@ -370,3 +700,943 @@ size_t stripPrefixSuffix(const char* word, const char* pattern, bool isPrefix,
     free(prepared);
     return 0;
 }
+
+static void buildAutomaton(struct Automaton* automaton,
+        const struct PatternElement* elements, size_t numElements,
+        bool reverse) {
+    automaton->numStates = numElements + 1;
+    automaton->numWords = (automaton->numStates + 63) / 64;
+    size_t numWords = automaton->numWords;
+    automaton->stars = calloc(numWords, sizeof(uint64_t));
+    automaton->transitions = calloc(256 * numWords, sizeof(uint64_t));
+    if (!automaton->stars || !automaton->transitions) err(1, "malloc");
+
+    for (size_t i = 0; i < numElements; i++) {
+        const struct PatternElement* element =
+                &elements[reverse ? numElements - 1 - i : i];
+        uint64_t bit = UINT64_C(1) << (i % 64);
+        if (element->star) {
+            automaton->stars[i / 64] |= bit;
+        }
+        for (size_t j = 0; j < 256 / 64; j++) {
+            for (uint64_t set = element->set[j]; set; set &= set - 1) {
+                size_t c = j * 64 + __builtin_ctzll(set);
+                automaton->transitions[c * numWords + i / 64] |= bit;
+            }
+        }
+    }
+}
+
+static int compareStrings(const void* a, const void* b) {
+    return strcmp(*(const char**) a, *(const char**) b);
+}
+
+// Removes a listing from the cache. Listings that are still being iterated
+// are freed when they are released.
+static void evictDirectoryListing(size_t index) {
+    struct DirectoryListing* listing = listings[index];
+    directoryCache.numNames -= listing->numNames;
+    listings[index] = listings[--directoryCache.numEntries];
+    listing->cached = false;
+    if (listing->users == 0) {
+        listing->users++;
+        releaseDirectoryListing(listing);
+    }
+}
+
+// Compiles a pattern as returned by preparePattern. Returns NULL if the
+// pattern uses features that are left to fnmatch.
+static struct CompiledPattern* compilePattern(const char* pattern) {
+    struct PatternElement* elements = NULL;
+    size_t numElements = 0;
+
+    const char* p = pattern;
+    while (*p) {
+        struct PatternElement element = {0};
+        if (*p == '*') {
+            p++;
+            if (numElements > 0 && elements[numElements - 1].star) continue;
+            element.star = true;
+            memset(element.set, 0xFF, sizeof(element.set));
+        } else if (*p == '?') {
+            p++;
+            memset(element.set, 0xFF, sizeof(element.set));
+        } else if (*p == '[') {
+            const char* end = parseBracketExpression(p + 1, element.set);
+            if (!end) {
+                free(elements);
+                return NULL;
+            }
+            if (end == p + 1) {
+                // Not a bracket expression, so the [ is matched literally.
+                memset(element.set, 0, sizeof(element.set));
+                element.set['[' / 64] |= UINT64_C(1) << ('[' % 64);
+                p++;
+            } else {
+                p = end;
+            }
+        } else {
+            if (*p == '\\') {
+                p++;
+                if (!*p) {
+                    free(elements);
+                    return NULL;
+                }
+            }
+            unsigned char c = *p++;
+            element.set[c / 64] |= UINT64_C(1) << (c % 64);
+        }
+        addToArray((void**) &elements, &numElements, &element,
+                sizeof(element));
+    }
+
+    struct CompiledPattern* result = malloc(sizeof(struct CompiledPattern));
+    if (!result) err(1, "malloc");
+    buildAutomaton(&result->forward, elements, numElements, false);
+    result->reverse.stars = NULL;
+    result->reverse.transitions = NULL;
+    result->elements = elements;
+    result->numElements = numElements;
+    return result;
+}
+
+// Expands the pattern and converts it to the syntax used by fnmatch. Returns
+// NULL if expansion fails.
+static char* expandPattern(const struct Word* pattern) {
+    struct ExpandContext context;
+    char** fields;
+    ssize_t numFields = expand2(pattern, EXPAND_NO_FIELD_SPLIT, &fields,
+            &context);
+    if (numFields < 0) return NULL;
+
+    bool containsSpecial;
+    char* prepared = preparePattern(fields[0], 0, context.substitutions,
+            context.numSubstitutions, false, &containsSpecial);
+    free(context.substitutions);
+    free(context.temp);
+    free(fields);
+    return prepared;
+}
+
+static struct CachedPattern* findCachedPattern(const char* text, bool raw) {
+    return &patternCache[(hashString(text) ^ raw) % PATTERN_CACHE_SIZE];
+}
+
+static void freeCompiledPattern(struct CompiledPattern* pattern) {
+    if (!pattern) return;
+    free(pattern->forward.stars);
+    free(pattern->forward.transitions);
+    free(pattern->reverse.stars);
+    free(pattern->reverse.transitions);
+    free(pattern->elements);
+    free(pattern);
+}
+
+// Returns the compiled pattern. If the pattern cannot be compiled NULL is
+// returned and *prepared is set to the pattern for fnmatch, which is also NULL
+// if expansion failed.
+static struct CompiledPattern* getCompiledPattern(const struct Word* pattern,
+        char** prepared) {
+    *prepared = NULL;
+
+    // Patterns without substitutions always expand to the same pattern, so we
+    // can avoid expanding them again.
+    bool raw = !strpbrk(pattern->text, "$`");
+    struct CachedPattern* entry = findCachedPattern(pattern->text, raw);
+    if (raw && entry->raw && entry->pattern &&
+            strcmp(entry->text, pattern->text) == 0) {
+        return entry->pattern;
+    }
+
+    char* text = expandPattern(pattern);
+    if (!text) return NULL;
+
+    if (!raw) {
+        entry = findCachedPattern(text, false);
+        if (!entry->raw && entry->text && strcmp(entry->text, text) == 0) {
+            if (!entry->pattern) {
+                *prepared = text;
+                return NULL;
+            }
+            free(text);
+            return entry->pattern;
+        }
+    }
+
+    struct CompiledPattern* compiled = compilePattern(text);
+    free(entry->text);
+    freeCompiledPattern(entry->pattern);
+    entry->text = strdup(raw ? pattern->text : text);
+    if (!entry->text) err(1, "strdup");
+    entry->raw = raw;
+    entry->pattern = compiled;
+
+    if (compiled) {
+        free(text);
+    } else {
+        *prepared = text;
+    }
+    return compiled;
+}
+
+// Returns the entries of the directory, which are read unless they are
+// cached. The listing must be released after use.
+static struct DirectoryListing* getDirectoryListing(int fd) {
+    struct stat st;
+    if (fstat(fd, &st) < 0) return NULL;
+
+    lockDirectoryCache();
+    for (size_t i = 0; i < directoryCache.numEntries; i++) {
+        struct DirectoryListing* listing = listings[i];
+        if (listing->device != st.st_dev || listing->inode != st.st_ino) {
+            continue;
+        }
+        if (listing->modified.tv_sec == st.st_mtim.tv_sec &&
+                listing->modified.tv_nsec == st.st_mtim.tv_nsec &&
+                listing->changed.tv_sec == st.st_ctim.tv_sec &&
+                listing->changed.tv_nsec == st.st_ctim.tv_nsec) {
+            directoryCache.hits++;
+            listing->lastUse = ++directoryCache.useCounter;
+            listing->users++;
+            unlockDirectoryCache();
+            return listing;
+        }
+        // The directory has been modified.
+        evictDirectoryListing(i);
+        break;
+    }
+    directoryCache.misses++;
+    unlockDirectoryCache();
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    int readFd = dup(fd);
+    if (readFd < 0) return NULL;
+    DIR* dir = fdopendir(readFd);
+    if (!dir) {
+        close(readFd);
+        return NULL;
+    }
+
+    struct DirectoryListing* listing = malloc(sizeof(struct DirectoryListing));
+    if (!listing) err(1, "malloc");
+    listing->device = st.st_dev;
+    listing->inode = st.st_ino;
+    listing->modified = st.st_mtim;
+    listing->changed = st.st_ctim;
+    listing->offsets = NULL;
+    listing->types = NULL;
+    listing->numNames = 0;
+    listing->users = 1;
+    listing->cached = false;
+
+    struct StringBuffer names;
+    initStringBuffer(&names);
+    size_t allocated = 0;
+    struct dirent* dirent;
+    while ((dirent = readdir(dir))) {
+        if (listing->numNames == allocated) {
+            allocated = allocated ? 2 * allocated : 64;
+            listing->offsets = reallocarray(listing->offsets, allocated,
+                    sizeof(size_t));
+            listing->types = realloc(listing->types, allocated);
+            if (!listing->offsets || !listing->types) err(1, "realloc");
+        }
+        listing->offsets[listing->numNames] = names.used;
+        listing->types[listing->numNames] = dirent->d_type;
+        listing->numNames++;
+        appendBytesToStringBuffer(&names, dirent->d_name,
+                strlen(dirent->d_name) + 1);
+    }
+    closedir(dir);
+    listing->names = finishStringBuffer(&names);
+
+    // File timestamps have a limited granularity, so a directory that was
+    // modified too recently might be modified again without any visible
+    // change. Such directories are not cached.
+    if (st.st_mtim.tv_sec + 1 >= now.tv_sec ||
+            st.st_ctim.tv_sec + 1 >= now.tv_sec) {
+        return listing;
+    }
+
+    lockDirectoryCache();
+    size_t maxEntries = directoryCache.maxEntries;
+    for (size_t i = 0; i < directoryCache.numEntries; i++) {
+        // Another thread has read the same directory in the meantime.
+        if (listings[i]->device == st.st_dev &&
+                listings[i]->inode == st.st_ino) {
+            maxEntries = 0;
+            break;
+        }
+    }
+    if (maxEntries == 0) {
+        unlockDirectoryCache();
+        return listing;
+    }
+    if (directoryCache.numEntries >= maxEntries) {
+        // Evict the least recently used listing.
+        resizeDirectoryCache(maxEntries - 1);
+        directoryCache.maxEntries = maxEntries;
+    }
+
+    listing->cached = true;
+    listing->lastUse = ++directoryCache.useCounter;
+    addToArray((void**) &listings, &directoryCache.numEntries, &listing,
+            sizeof(listing));
+    directoryCache.numNames += listing->numNames;
+    unlockDirectoryCache();
+    return listing;
+}
+
+// Matches the components starting at index against the directory entries.
+// The path of the directory relative to dirFd begins at the given offset in
+// the path.
+static void globDirectory(struct Glob* glob, int dirFd, size_t relative,
+        size_t index) {
+    struct StringBuffer* path = &glob->path;
+    size_t length = path->used;
+
+    // Literal components are only appended to the path. No directory needs to
+    // be read for them.
+    while (index < glob->numComponents &&
+            glob->components[index].literal) {
+        const struct GlobComponent* component = &glob->components[index];
+        for (size_t i = 0; i < component->slashes; i++) {
+            appendToStringBuffer(path, '/');
+        }
+        appendStringToStringBuffer(path, component->text);
+        index++;
+    }
+
+    if (index == glob->numComponents) {
+        path->buffer[path->used] = '\0';
+        struct stat st;
+        // The path is empty when a pattern ending with **/ matches the
+        // current directory.
+        if (path->used > 0 && (path->used == length ||
+                fstatat(dirFd, path->buffer + relative, &st,
+                AT_SYMLINK_NOFOLLOW) == 0)) {
+            char* pathname = strdup(path->buffer);
+            if (!pathname) err(1, "strdup");
+            addToArray((void**) glob->pathnames, glob->numPathnames,
+                    &pathname, sizeof(char*));
+        }
+        path->used = length;
+        return;
+    }
+
+    const struct GlobComponent* component = &glob->components[index];
+    for (size_t i = 0; i < component->slashes; i++) {
+        appendToStringBuffer(path, '/');
+    }
+    if (component->globstar) {
+        globRecursively(glob, dirFd, relative, index);
+        path->used = length;
+        return;
+    }
+    path->buffer[path->used] = '\0';
+    const char* dirname = path->buffer + relative;
+    int fd = openat(dirFd, *dirname ? dirname : ".",
+            O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        path->used = length;
+        return;
+    }
+
+    DIR* dir = NULL;
+    struct DirectoryListing* listing = NULL;
+    if (shellOptions.globcache) {
+        listing = getDirectoryListing(fd);
+    }
+    if (!listing) {
+        dir = fdopendir(fd);
+        if (!dir) {
+            close(fd);
+            path->used = length;
+            return;
+        }
+    }
+
+    bool last = index + 1 == glob->numComponents;
+    size_t nameOffset = path->used;
+    size_t entry = 0;
+    // With multiple workers the matching subdirectories are collected first
+    // and then searched concurrently.
+    bool parallel = !last && glob->workers > 1;
+    char** subdirectories = NULL;
+    size_t numSubdirectories = 0;
+    while (true) {
+        const char* name;
+        unsigned char type;
+        if (listing) {
+            if (entry >= listing->numNames) break;
+            name = listing->names + listing->offsets[entry];
+            type = listing->types[entry];
+            entry++;
+        } else {
+            struct dirent* dirent = readdir(dir);
+            if (!dirent) break;
+            name = dirent->d_name;
+            type = dirent->d_type;
+        }
+
+        // Only directories can contain further components.
+        if (!last && type != DT_DIR && type != DT_LNK && type != DT_UNKNOWN) {
+            continue;
+        }
+        if (!matchesGlobComponent(component, name)) continue;
+
+        if (parallel) {
+            char* subdirectory = strdup(name);
+            if (!subdirectory) err(1, "strdup");
+            addToArray((void**) &subdirectories, &numSubdirectories,
+                    &subdirectory, sizeof(char*));
+            continue;
+        }
+
+        appendStringToStringBuffer(path, name);
+        if (last) {
+            path->buffer[path->used] = '\0';
+            char* pathname = strdup(path->buffer);
+            if (!pathname) err(1, "strdup");
+            addToArray((void**) glob->pathnames, glob->numPathnames,
+                    &pathname, sizeof(char*));
+        } else {
+            globDirectory(glob, fd, nameOffset, index + 1);
+        }
+        path->used = nameOffset;
+    }
+
+    if (numSubdirectories > 0) {
+        globInParallel(glob, fd, nameOffset, index + 1, subdirectories,
+                numSubdirectories);
+        for (size_t i = 0; i < numSubdirectories; i++) {
+            free(subdirectories[i]);
+        }
+        free(subdirectories);
+    }
+
+    if (listing) {
+        lockDirectoryCache();
+        releaseDirectoryListing(listing);
+        unlockDirectoryCache();
+        close(fd);
+    } else {
+        closedir(dir);
+    }
+    path->used = length;
+}
+
+// Searches the subdirectories for the components starting at index. If the
+// platform supports threads and there are multiple subdirectories they are
+// distributed among the workers.
+static void globInParallel(struct Glob* glob, int dirFd, size_t relative,
+        size_t index, char** names, size_t numNames) {
+#if HAVE_PTHREAD
+    if (numNames > 1) {
+        globWithThreads(glob, dirFd, relative, index, names, numNames);
+        return;
+    }
+#endif
+    struct StringBuffer* path = &glob->path;
+    for (size_t i = 0; i < numNames; i++) {
+        appendStringToStringBuffer(path, names[i]);
+        globDirectory(glob, dirFd, relative, index);
+        path->used = relative;
+    }
+}
+
+#if HAVE_PTHREAD
+static void globWithThreads(struct Glob* glob, int dirFd, size_t relative,
+        size_t index, char** names, size_t numNames) {
+    struct GlobWork work;
+    work.glob = glob;
+    work.dirFd = dirFd;
+    work.index = index;
+    work.prefix = glob->path.buffer;
+    work.prefixLength = relative;
+    work.names = names;
+    work.numNames = numNames;
+    work.next = 0;
+    pthread_mutex_init(&work.mutex, NULL);
+
+    size_t numThreads = glob->workers - 1;
+    if (numThreads > numNames - 1) {
+        numThreads = numNames - 1;
+    }
+    pthread_t* threads = NULL;
+    size_t created = 0;
+    if (numThreads > 0) {
+        threads = malloc(numThreads * sizeof(pthread_t));
+        if (!threads) err(1, "malloc");
+
+        // Signals must be handled by the main thread.
+        sigset_t set, oldSet;
+        sigfillset(&set);
+        pthread_sigmask(SIG_SETMASK, &set, &oldSet);
+        while (created < numThreads && pthread_create(&threads[created],
+                NULL, globWorker, &work) == 0) {
+            created++;
+        }
+        pthread_sigmask(SIG_SETMASK, &oldSet, NULL);
+    }
+
+    // The main thread also takes part. If no threads could be created it
+    // searches all subdirectories on its own.
+    globWorker(&work);
+    for (size_t i = 0; i < created; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+    pthread_mutex_destroy(&work.mutex);
+}
+#endif
+
+// Adds the pathnames matching a pattern as returned by preparePattern. The
+// pattern is modified.
+static void globPathnames(char* pattern, char*** pathnames,
+        size_t* numPathnames) {
+    struct Glob glob;
+    glob.components = NULL;
+    glob.numComponents = 0;
+    glob.pathnames = pathnames;
+    glob.numPathnames = numPathnames;
+    glob.workers = getGlobWorkers();
+
+    char* p = pattern;
+    size_t slashes = 0;
+    while (true) {
+        while (*p == '/') {
+            slashes++;
+            p++;
+        }
+
+        struct GlobComponent component;
+        component.slashes = slashes;
+        component.text = p;
+        component.literal = true;
+        while (*p && *p != '/') {
+            if (*p == '\\' && p[1]) {
+                p++;
+            } else if (*p == '*' || *p == '?' || *p == '[') {
+                component.literal = false;
+            }
+            p++;
+        }
+        bool end = !*p;
+        if (!end) {
+            // The slash is counted for the next component, which may be empty
+            // if the pattern ends with a slash.
+            *p++ = '\0';
+            slashes = 1;
+        }
+
+        component.globstar = shellOptions.globstar &&
+                strcmp(component.text, "**") == 0;
+        bool afterGlobstar = glob.numComponents > 0 &&
+                glob.components[glob.numComponents - 1].globstar;
+        if (afterGlobstar) {
+            // The directories matched by ** already end with a slash.
+            component.slashes = 0;
+            if (component.globstar) {
+                // Consecutive ** components are collapsed into one.
+                if (end) break;
+                continue;
+            }
+        }
+
+        component.compiled = NULL;
+        if (component.literal) {
+            // Remove the backslashes.
+            char* to = component.text;
+            for (const char* from = component.text; *from; from++) {
+                if (*from == '\\' && from[1]) from++;
+                *to++ = *from;
+            }
+            *to = '\0';
+        } else if (!component.globstar) {
+            component.compiled = compilePattern(component.text);
+        }
+        addToArray((void**) &glob.components, &glob.numComponents,
+                &component, sizeof(component));
+        if (end) break;
+    }
+
+    initStringBuffer(&glob.path);
+    globDirectory(&glob, AT_FDCWD, 0, 0);
+    freeStringBuffer(&glob.path);
+
+    for (size_t i = 0; i < glob.numComponents; i++) {
+        freeCompiledPattern(glob.components[i].compiled);
+    }
+    free(glob.components);
+}
+
+// Returns the number of threads used for pathname expansion. It is set by the
+// DXSH_GLOB_WORKERS variable, and expansion is sequential by default.
+static size_t getGlobWorkers(void) {
+    const char* value = getVariable("DXSH_GLOB_WORKERS");
+    if (!value || !*value) return 1;
+    char* end;
+    unsigned long workers = strtoul(value, &end, 10);
+    if (*end || workers == 0) return 1;
+    return workers < MAX_GLOB_WORKERS ? workers : MAX_GLOB_WORKERS;
+}
+
+#if HAVE_PTHREAD
+static void* globWorker(void* arg) {
+    struct GlobWork* work = arg;
+    char** pathnames = NULL;
+    size_t numPathnames = 0;
+
+    struct Glob glob = *work->glob;
+    glob.pathnames = &pathnames;
+    glob.numPathnames = &numPathnames;
+    // Worker threads do not create further threads.
+    glob.workers = 1;
+    initStringBuffer(&glob.path);
+    appendBytesToStringBuffer(&glob.path, work->prefix, work->prefixLength);
+
+    while (true) {
+        pthread_mutex_lock(&work->mutex);
+        size_t i = work->next++;
+        pthread_mutex_unlock(&work->mutex);
+        if (i >= work->numNames) break;
+
+        appendStringToStringBuffer(&glob.path, work->names[i]);
+        globDirectory(&glob, work->dirFd, work->prefixLength, work->index);
+        glob.path.used = work->prefixLength;
+    }
+    freeStringBuffer(&glob.path);
+
+    // The results are sorted later, so their order does not matter here.
+    if (numPathnames > 0) {
+        pthread_mutex_lock(&work->mutex);
+        char*** results = work->glob->pathnames;
+        size_t* numResults = work->glob->numPathnames;
+        *results = reallocarray(*results, *numResults + numPathnames,
+                sizeof(char*));
+        if (!*results) err(1, "realloc");
+        memcpy(*results + *numResults, pathnames,
+                numPathnames * sizeof(char*));
+        *numResults += numPathnames;
+        pthread_mutex_unlock(&work->mutex);
+    }
+    free(pathnames);
+    return NULL;
+}
+#endif
+
+// Matches the components after the ** component at index in the directory and
+// in all its subdirectories. Hidden directories and symbolic links to
+// directories are not entered, and a directory that is already being walked
+// is skipped if it is reached again.
+static void globRecursively(struct Glob* glob, int dirFd, size_t relative,
+        size_t index) {
+    struct StringBuffer* path = &glob->path;
+    path->buffer[path->used] = '\0';
+    const char* dirname = path->buffer + relative;
+    int fd = openat(dirFd, *dirname ? dirname : ".",
+            O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) return;
+
+    // Entries can be matched directly while walking if ** is followed by at
+    // most one pattern. Otherwise the remaining components are matched
+    // separately in each directory.
+    bool matchAll = index + 1 == glob->numComponents;
+    const struct GlobComponent* final = NULL;
+    if (index + 2 == glob->numComponents &&
+            !glob->components[index + 1].literal) {
+        final = &glob->components[index + 1];
+    }
+    // The walk itself is sequential, so no threads are created for the
+    // remaining components.
+    size_t workers = glob->workers;
+    glob->workers = 1;
+
+    struct WalkDirectory* stack = NULL;
+    size_t numDirectories = 0;
+    while (true) {
+        // Directories are only entered once to avoid loops through bind
+        // mounts.
+        struct stat st;
+        bool entered = fstat(fd, &st) < 0;
+        for (size_t i = 0; !entered && i < numDirectories; i++) {
+            entered = stack[i].device == st.st_dev &&
+                    stack[i].inode == st.st_ino;
+        }
+        DIR* dir = entered ? NULL : fdopendir(fd);
+        if (dir) {
+            struct WalkDirectory directory;
+            directory.dir = dir;
+            directory.device = st.st_dev;
+            directory.inode = st.st_ino;
+            directory.pathLength = path->used;
+            addToArray((void**) &stack, &numDirectories, &directory,
+                    sizeof(directory));
+            if (!matchAll && !final) {
+                globDirectory(glob, fd, path->used, index + 1);
+            }
+        } else {
+            close(fd);
+        }
+        fd = -1;
+
+        while (numDirectories > 0 && fd < 0) {
+            struct WalkDirectory* top = &stack[numDirectories - 1];
+            struct dirent* dirent = readdir(top->dir);
+            if (!dirent) {
+                closedir(top->dir);
+                numDirectories--;
+                continue;
+            }
+
+            const char* name = dirent->d_name;
+            if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) continue;
+            path->used = top->pathLength;
+            appendStringToStringBuffer(path, name);
+            if ((matchAll && name[0] != '.') ||
+                    (final && matchesGlobComponent(final, name))) {
+                path->buffer[path->used] = '\0';
+                char* pathname = strdup(path->buffer);
+                if (!pathname) err(1, "strdup");
+                addToArray((void**) glob->pathnames, glob->numPathnames,
+                        &pathname, sizeof(char*));
+            }
+
+            unsigned char type = dirent->d_type;
+            if (name[0] != '.' && (type == DT_DIR || type == DT_UNKNOWN)) {
+                fd = openat(dirfd(top->dir), name,
+                        O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+                appendToStringBuffer(path, '/');
+            }
+        }
+        if (fd < 0) break;
+    }
+
+    free(stack);
+    glob->workers = workers;
+}
+
+static size_t hashString(const char* text) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (const char* p = text; *p; p++) {
+        hash = (hash ^ (unsigned char) *p) * 16777619u;
+    }
+    return hash;
+}
+
+static void lockDirectoryCache(void) {
+#if HAVE_PTHREAD
+    pthread_mutex_lock(&listingsMutex);
+#endif
+}
+
+static bool matchesCompiledPattern(const struct CompiledPattern* pattern,
+        const char* word) {
+    size_t length = strlen(word);
+    bool matched;
+    size_t matchLength = matchAutomaton(&pattern->forward, word, length,
+            false, true, &matched);
+    return matched && matchLength == length;
+}
+
+static bool matchesGlobComponent(const struct GlobComponent* component,
+        const char* name) {
+    // A leading period in a filename must be matched explicitly.
+    const char* text = component->text;
+    if (name[0] == '.' && text[0] != '.' &&
+            !(text[0] == '\\' && text[1] == '.')) {
+        return false;
+    }
+
+    if (component->compiled) {
+        return matchesCompiledPattern(component->compiled, name);
+    }
+    return fnmatch(text, name, FNM_PERIOD) == 0;
+}
+
+// Matches the automaton against the start of the word, or against its end if
+// reverse is true. Returns the length of the shortest or longest match.
+static size_t matchAutomaton(const struct Automaton* automaton,
+        const char* word, size_t length, bool reverse, bool greedy,
+        bool* matched) {
+    size_t numWords = automaton->numWords;
+    const uint64_t* stars = automaton->stars;
+    size_t acceptWord = (automaton->numStates - 1) / 64;
+    uint64_t acceptBit = UINT64_C(1) << ((automaton->numStates - 1) % 64);
+
+    uint64_t stackStates[4];
+    uint64_t* states = stackStates;
+    if (numWords > 4) {
+        states = malloc(numWords * sizeof(uint64_t));
+        if (!states) err(1, "malloc");
+    }
+
+    // Begin in state 0 and follow asterisks that match the empty string.
+    memset(states, 0, numWords * sizeof(uint64_t));
+    states[0] = 1;
+    states[0] |= (states[0] & stars[0]) << 1;
+
+    *matched = false;
+    size_t result = 0;
+    for (size_t i = 0; ; i++) {
+        if (states[acceptWord] & acceptBit) {
+            *matched = true;
+            result = i;
+            if (!greedy) break;
+        }
+        if (i == length) break;
+
+        unsigned char c = word[reverse ? length - 1 - i : i];
+        const uint64_t* transitions = automaton->transitions + c * numWords;
+        uint64_t carry = 0;
+        uint64_t any = 0;
+        for (size_t j = 0; j < numWords; j++) {
+            uint64_t active = states[j] & transitions[j];
+            // States at an asterisk stay, all others advance.
+            uint64_t advance = active & ~stars[j];
+            uint64_t next = advance << 1 | carry | (active & stars[j]);
+            carry = advance >> 63;
+            // An asterisk can also match the empty string.
+            uint64_t skip = (next & stars[j]) << 1;
+            next |= skip;
+            carry |= (next & stars[j]) >> 63;
+            states[j] = next;
+            any |= next;
+        }
+        if (!any) break;
+    }
+
+    if (states != stackStates) {
+        free(states);
+    }
+    return result;
+}
+
+// Parses a single character in a bracket expression, which may be given as a
+// collating symbol or equivalence class.
+static bool parseBracketChar(const char** p, unsigned char* c) {
+    const char* s = *p;
+    if (s[0] == '[' && (s[1] == '.' || s[1] == '=')) {
+        // Only single character collating elements are supported.
+        if (!s[2] || s[2] == '\\' || s[3] != s[1] || s[4] != ']') {
+            return false;
+        }
+        *c = s[2];
+        *p = s + 5;
+        return true;
+    }
+    *c = *s;
+    *p = s + 1;
+    return true;
+}
+
+// Parses the bracket expression following a [. Returns a pointer after the
+// expression, the argument if it is not a valid bracket expression or NULL if
+// the expression cannot be compiled.
+static const char* parseBracketExpression(const char* p, uint64_t* set) {
+    static const struct {
+        const char* name;
+        int (*function)(int);
+    } classes[] = {
+        { "alnum", isalnum }, { "alpha", isalpha }, { "blank", isblank },
+        { "cntrl", iscntrl }, { "digit", isdigit }, { "graph", isgraph },
+        { "lower", islower }, { "print", isprint }, { "punct", ispunct },
+        { "space", isspace }, { "upper", isupper }, { "xdigit", isxdigit },
+    };
+
+    const char* begin = p;
+    bool negated = *p == '!' || *p == '^';
+    if (negated) p++;
+
+    bool first = true;
+    while (*p != ']' || first) {
+        if (!*p) return begin;
+
+        if (p[0] == '[' && p[1] == ':') {
+            const char* name = p + 2;
+            const char* end = strstr(name, ":]");
+            if (!end) return NULL;
+            size_t i;
+            for (i = 0; i < sizeof(classes) / sizeof(classes[0]); i++) {
+                if (strlen(classes[i].name) == (size_t) (end - name) &&
+                        strncmp(classes[i].name, name, end - name) == 0) {
+                    break;
+                }
+            }
+            if (i == sizeof(classes) / sizeof(classes[0])) return NULL;
+            for (int c = 0; c < 256; c++) {
+                if (classes[i].function(c)) {
+                    set[c / 64] |= UINT64_C(1) << (c % 64);
+                }
+            }
+            p = end + 2;
+            first = false;
+            continue;
+        }
+
+        bool equivalence = p[0] == '[' && p[1] == '=';
+        unsigned char low;
+        if (!parseBracketChar(&p, &low)) return NULL;
+        unsigned char high = low;
+        if (!equivalence && p[0] == '-' && p[1] != ']' && p[1]) {
+            p++;
+            if ((p[0] == '[' && (p[1] == '=' || p[1] == ':')) ||
+                    !parseBracketChar(&p, &high) || high < low) {
+                return NULL;
+            }
+        }
+        for (unsigned int c = low; c <= high; c++) {
+            set[c / 64] |= UINT64_C(1) << (c % 64);
+        }
+        first = false;
+    }
+
+    if (negated) {
+        for (size_t i = 0; i < 256 / 64; i++) {
+            set[i] = ~set[i];
+        }
+    }
+    return p + 1;
+}
+
+static void releaseCasePatterns(void* object) {
+    struct CasePatterns* patterns = object;
+    for (size_t i = 0; i < patterns->numPatterns; i++) {
+        freeCompiledPattern(patterns->patterns[i].compiled);
+        free(patterns->patterns[i].prepared);
+    }
+}
+
+static void releaseDirectoryListing(struct DirectoryListing* listing) {
+    if (--listing->users > 0 || listing->cached) return;
+    free(listing->names);
+    free(listing->offsets);
+    free(listing->types);
+    free(listing);
+}
+
+// Removes duplicates from sorted pathnames starting at first. These occur if a
+// pattern contains multiple ** components.
+static void removeDuplicates(char** pathnames, size_t* numPathnames,
+        size_t first) {
+    size_t count = *numPathnames - first;
+    size_t kept = 1;
+    for (size_t i = 1; i < count; i++) {
+        if (strcmp(pathnames[i], pathnames[kept - 1]) == 0) {
+            free(pathnames[i]);
+        } else {
+            pathnames[kept++] = pathnames[i];
+        }
+    }
+    *numPathnames = first + kept;
+}
+
+static void unlockDirectoryCache(void) {
+#if HAVE_PTHREAD
+    pthread_mutex_unlock(&listingsMutex);
+#endif
+}
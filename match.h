@@ -20,13 +20,38 @@
 #ifndef MATCH_H
 #define MATCH_H
 
+#include "arena.h"
 #include "expand.h"
+#include "parser.h"
 
-bool matchesPattern(const char* expandedWord, const char* pattern);
+struct CasePatterns;
+
+// Directory listings that are reused by pathname expansion if the globcache
+// option is set.
+struct DirectoryCache {
+    size_t maxEntries;
+    size_t numEntries;
+    // The number of directory entries in all cached listings.
+    size_t numNames;
+    unsigned long useCounter;
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+};
+
+extern struct DirectoryCache directoryCache;
+
+struct CasePatterns* createCasePatterns(struct Arena* arena,
+        const struct CaseClause* clause);
+// Returns the index of the first item with a matching pattern or SIZE_MAX.
+size_t findCaseItem(struct CasePatterns* patterns, const char* word);
+void clearDirectoryCache(void);
+bool matchesPattern(const char* expandedWord, const struct Word* pattern);
 bool expandPathnames(char** fields, size_t numFields, char*** pathnames,
         size_t* numPathnames, struct SubstitutionInfo* subst,
         size_t numSubstitutions);
-size_t stripPrefixSuffix(const char* word, const char* pattern, bool isPrefix,
-        bool greedy);
+void resizeDirectoryCache(size_t maxEntries);
+size_t stripPrefixSuffix(const char* word, const struct Word* pattern,
+        bool isPrefix, bool greedy);
 
 #endif
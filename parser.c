@@ -1,4 +1,4 @@
-/* Copyright (c) 2018, 2019, 2020, 2021, 2022, 2025 Dennis Wölfing
+/* Copyright (c) 2018, 2019, 2020, 2021, 2022, 2025, 2026 Dennis Wölfing
  *
  * Permission to use, copy, modify, and/or distribute this software for any
  * purpose with or without fee is hereby granted, provided that the above
@@ -27,10 +27,13 @@
 #include <string.h>
 
 #include "dxsh.h"
+#include "match.h"
 #include "parser.h"
+#include "word.h"
 
 #define BACKTRACKING // specify that a function might return PARSER_BACKTRACK.
 
+static struct Word* copyWord(struct Parser* parser, struct Token* token);
 static enum ParserResult parseCommand(struct Parser* parser,
         struct Command* command);
 static enum ParserResult parseCompoundListWithTerminator(struct Parser* parser,
@@ -52,21 +55,18 @@ static enum ParserResult parsePipeline(struct Parser* parser,
         struct Pipeline* pipeline);
 static enum ParserResult parseSimpleCommand(struct Parser* parser,
         struct SimpleCommand* command);
-static void syntaxError(struct Token* token);
-
-static void freeCommand(struct Command* command);
-static void freeList(struct List* list);
-static void freePipeline(struct Pipeline* pipeline);
-static void freeSimpleCommand(struct SimpleCommand* command);
-static void freeRedirection(struct Redirection* redirection);
+static void releaseFunction(void* function);
+static void syntaxError(struct Parser* parser, struct Token* token);
 
 static inline struct Token* getToken(struct Parser* parser) {
     if (parser->offset >= parser->tokenizer.numTokens) {
-        if (!*parser->tokenizer.input) return NULL;
+        if (parser->tokenizer.input == parser->tokenizer.inputEnd) {
+            return NULL;
+        }
 
         enum TokenizerResult tokenResult = splitTokens(&parser->tokenizer);
         if (tokenResult == TOKENIZER_PREMATURE_EOF) {
-            syntaxError(NULL);
+            syntaxError(parser, NULL);
             return NULL;
         } else if (tokenResult == TOKENIZER_SYNTAX_ERROR) {
             return NULL;
@@ -80,10 +80,11 @@ void freeParser(struct Parser* parser) {
 }
 
 void initParser(struct Parser* parser,
-        bool (*readInput)(const char** str, bool newCommand, void* context),
-        void* context) {
+        bool (*readInput)(const char** str, size_t* length, bool newCommand,
+        void* context), void* context) {
     parser->offset = 0;
     parser->hereDocOffset = 0;
+    parser->arena = NULL;
     initTokenizer(&parser->tokenizer, readInput, context);
 }
 
@@ -134,20 +135,24 @@ enum ParserResult parse(struct Parser* parser,
         }
     }
 
+    initArena(&command->arena);
+    parser->arena = &command->arena;
     enum ParserResult result = parseList(parser, &command->list, false,
             readWholeScript);
     assert(result != PARSER_BACKTRACK);
 
-    if (result == PARSER_MATCH && (*parser->tokenizer.input ||
+    if (result == PARSER_MATCH &&
+            (parser->tokenizer.input != parser->tokenizer.inputEnd ||
             parser->tokenizer.wordStatus != WORDSTATUS_NONE ||
             parser->offset < parser->tokenizer.numTokens - 1)) {
-        syntaxError(getToken(parser));
-        freeList(&command->list);
-        return PARSER_SYNTAX;
+        result = PARSER_SYNTAX;
     }
 
     if (result == PARSER_SYNTAX) {
-        syntaxError(getToken(parser));
+        syntaxError(parser, getToken(parser));
+    }
+    if (result != PARSER_MATCH) {
+        freeArena(&command->arena);
     }
     return result;
 }
@@ -165,33 +170,39 @@ enum ParserResult parseCommandSubstitution(struct Parser* parser,
     struct Token* token = getToken(parser);
     if (!token) return PARSER_SYNTAX;
     if (token->type == OPERATOR && strcmp(token->text, ")") == 0) {
-        *inputRemaining = strlen(parser->tokenizer.input);
+        *inputRemaining = parser->tokenizer.inputEnd -
+                parser->tokenizer.input;
         return PARSER_NO_CMD;
     }
 
     struct CompleteCommand dummy;
     dummy.prevCommand = NULL;
     struct CompleteCommand* parsedCommand = command ? command : &dummy;
+    initArena(&parsedCommand->arena);
+    parser->arena = &parsedCommand->arena;
     result = parseList(parser, &parsedCommand->list, true, true);
     if (result == PARSER_MATCH) {
-        if (!command) {
-            freeCompleteCommand(&dummy);
-        }
-
         token = getToken(parser);
         if (!token || token->type != OPERATOR ||
                 strcmp(token->text, ")") != 0) {
-            if (command) {
-                freeCompleteCommand(command);
-            }
-            return PARSER_SYNTAX;
+            result = PARSER_SYNTAX;
+        } else {
+            *inputRemaining = parser->tokenizer.inputEnd -
+                    parser->tokenizer.input;
         }
+    }
 
-        *inputRemaining = strlen(parser->tokenizer.input);
+    if (result != PARSER_MATCH || !command) {
+        freeArena(&parsedCommand->arena);
     }
     return result;
 }
 
+static struct Word* copyWord(struct Parser* parser, struct Token* token) {
+    char* text = arenaStrdup(parser->arena, token->text);
+    return lexWord(parser->arena, text, false, token);
+}
+
 static enum ParserResult parseList(struct Parser* parser, struct List* list,
         bool compound, bool allowLinebreak) {
     list->numPipelines = 0;
@@ -201,19 +212,20 @@ static enum ParserResult parseList(struct Parser* parser, struct List* list,
     enum ParserResult result;
     if (allowLinebreak) {
         result = parseLinebreak(parser);
-        if (result != PARSER_MATCH) goto fail;
+        if (result != PARSER_MATCH) return result;
     }
 
     while (true) {
         struct Pipeline pipeline;
         result = parsePipeline(parser, &pipeline);
-        if (result != PARSER_MATCH) goto fail;
+        if (result != PARSER_MATCH) return result;
 
-        addToArray((void**) &list->pipelines, &list->numPipelines, &pipeline,
-                sizeof(pipeline));
-        list->separators = realloc(list->separators, list->numPipelines);
-        if (!list->separators) err(1, "realloc");
-        list->separators[list->numPipelines - 1] = LIST_SEMI;
+        size_t numSeparators = list->numPipelines;
+        char separator = LIST_SEMI;
+        arenaAddToArray(parser->arena, (void**) &list->separators,
+                &numSeparators, &separator, 1);
+        arenaAddToArray(parser->arena, (void**) &list->pipelines,
+                &list->numPipelines, &pipeline, sizeof(pipeline));
 
         struct Token* token = getToken(parser);
         if (!token || token->type != OPERATOR) return PARSER_MATCH;
@@ -224,16 +236,16 @@ static enum ParserResult parseList(struct Parser* parser, struct List* list,
 
             parser->offset++;
             result = parseLinebreak(parser);
-            if (result != PARSER_MATCH) goto fail;
+            if (result != PARSER_MATCH) return result;
         } else if (strcmp(token->text, ";") == 0) {
             parser->offset++;
             if (allowLinebreak) {
                 result = parseLinebreak(parser);
-                if (result != PARSER_MATCH) goto fail;
+                if (result != PARSER_MATCH) return result;
             }
         } else if (allowLinebreak && strcmp(token->text, "\n") == 0) {
             result = parseLinebreak(parser);
-            if (result != PARSER_MATCH) goto fail;
+            if (result != PARSER_MATCH) return result;
         } else {
             // TODO: Implement asynchronous lists.
             return PARSER_MATCH;
@@ -242,10 +254,7 @@ static enum ParserResult parseList(struct Parser* parser, struct List* list,
         token = getToken(parser);
 
         if (compound && list->separators[list->numPipelines - 1] == LIST_SEMI) {
-            if (!token) {
-                result = PARSER_SYNTAX;
-                goto fail;
-            }
+            if (!token) return PARSER_SYNTAX;
             if (isCompoundListTerminator(token->text)) {
                 return PARSER_MATCH;
             }
@@ -255,10 +264,6 @@ static enum ParserResult parseList(struct Parser* parser, struct List* list,
             return PARSER_MATCH;
         }
     }
-
-fail:
-    freeList(list);
-    return result;
 }
 
 static enum ParserResult parsePipeline(struct Parser* parser,
@@ -282,10 +287,10 @@ static enum ParserResult parsePipeline(struct Parser* parser,
     while (true) {
         struct Command command;
         result = parseCommand(parser, &command);
-        if (result != PARSER_MATCH) goto fail;
+        if (result != PARSER_MATCH) return result;
 
-        addToArray((void**) &pipeline->commands, &pipeline->numCommands,
-                &command, sizeof(command));
+        arenaAddToArray(parser->arena, (void**) &pipeline->commands,
+                &pipeline->numCommands, &command, sizeof(command));
 
         token = getToken(parser);
         if (!token) return PARSER_MATCH;
@@ -296,15 +301,11 @@ static enum ParserResult parsePipeline(struct Parser* parser,
         parser->offset++;
 
         result = parseLinebreak(parser);
-        if (result != PARSER_MATCH) goto fail;
+        if (result != PARSER_MATCH) return result;
         token = getToken(parser);
     }
 
     return PARSER_MATCH;
-
-fail:
-    freePipeline(pipeline);
-    return result;
 }
 
 static enum ParserResult parseCompoundListWithTerminator(struct Parser* parser,
@@ -365,9 +366,6 @@ static enum ParserResult parseCommand(struct Parser* parser,
         if (result != PARSER_MATCH) return result;
         result = parseCompoundListWithTerminator(parser, &command->loop.body,
                 "done");
-        if (result != PARSER_MATCH) {
-            freeList(&command->loop.condition);
-        }
     } else if (strcmp(token->text, "until") == 0) {
         command->type = COMMAND_UNTIL;
         parser->offset++;
@@ -376,9 +374,6 @@ static enum ParserResult parseCommand(struct Parser* parser,
         if (result != PARSER_MATCH) return result;
         result = parseCompoundListWithTerminator(parser, &command->loop.body,
                 "done");
-        if (result != PARSER_MATCH) {
-            freeList(&command->loop.condition);
-        }
     } else {
         return PARSER_SYNTAX;
     }
@@ -396,13 +391,10 @@ static enum ParserResult parseCommand(struct Parser* parser,
         result = parseIoRedirect(parser, &redirection);
 
         if (result == PARSER_BACKTRACK) return PARSER_MATCH;
-        if (result != PARSER_MATCH) {
-            freeCommand(command);
-            return result;
-        }
+        if (result != PARSER_MATCH) return result;
 
-        addToArray((void**) &command->redirections, &command->numRedirections,
-                &redirection, sizeof(redirection));
+        arenaAddToArray(parser->arena, (void**) &command->redirections,
+                &command->numRedirections, &redirection, sizeof(redirection));
         token = getToken(parser);
         if (!token) return PARSER_MATCH;
     }
@@ -434,13 +426,12 @@ static enum ParserResult parseSimpleCommand(struct Parser* parser,
                         command->numAssignmentWords > 0) {
                     return PARSER_MATCH;
                 }
-                result = PARSER_SYNTAX;
-                goto fail;
+                return PARSER_SYNTAX;
             }
 
-            if (result != PARSER_MATCH) goto fail;
+            if (result != PARSER_MATCH) return result;
 
-            addToArray((void**) &command->redirections,
+            arenaAddToArray(parser->arena, (void**) &command->redirections,
                     &command->numRedirections, &redirection,
                     sizeof(redirection));
         } else {
@@ -449,17 +440,16 @@ static enum ParserResult parseSimpleCommand(struct Parser* parser,
             const char* equals = strchr(token->text, '=');
             if (!hadNonAssignmentWord && equals && equals != token->text &&
                     isName(token->text, equals - token->text)) {
-                char* word = strdup(token->text);
-                if (!word) err(1, "malloc");
-                addToArray((void**) &command->assignmentWords,
+                struct Word* word = copyWord(parser, token);
+                arenaAddToArray(parser->arena,
+                        (void**) &command->assignmentWords,
                         &command->numAssignmentWords, &word,
-                        sizeof(char*));
+                        sizeof(struct Word*));
             } else {
                 hadNonAssignmentWord = true;
-                char* word = strdup(token->text);
-                if (!word) err(1, "malloc");
-                addToArray((void**) &command->words, &command->numWords,
-                        &word, sizeof(char*));
+                struct Word* word = copyWord(parser, token);
+                arenaAddToArray(parser->arena, (void**) &command->words,
+                        &command->numWords, &word, sizeof(struct Word*));
             }
             parser->offset++;
         }
@@ -469,14 +459,11 @@ static enum ParserResult parseSimpleCommand(struct Parser* parser,
     }
 
     return PARSER_MATCH;
-
-fail:
-    freeSimpleCommand(command);
-    return result;
 }
 
 static BACKTRACKING enum ParserResult parseIoRedirect(struct Parser* parser,
         struct Redirection* result) {
+    result->word = NULL;
     result->filename = NULL;
     struct Token* token = getToken(parser);
     assert(token);
@@ -534,12 +521,16 @@ static BACKTRACKING enum ParserResult parseIoRedirect(struct Parser* parser,
             }
             hereDoc = &parser->tokenizer.hereDocs[parser->hereDocOffset];
         }
-        result->filename = strdup(hereDoc->content);
+        char* content = arenaStrdup(parser->arena, hereDoc->content);
+        if (result->type == REDIR_HERE_DOC) {
+            result->word = lexWord(parser->arena, content, true, NULL);
+        } else {
+            result->filename = content;
+        }
         parser->hereDocOffset++;
     } else {
-        result->filename = strdup(word->text);
+        result->word = copyWord(parser, word);
     }
-    if (!result->filename) err(1, "malloc");
 
     parser->offset++;
     return PARSER_MATCH;
@@ -554,57 +545,47 @@ static enum ParserResult parseForClause(struct Parser* parser,
     if (!token || !isName(token->text, strlen(token->text))) {
         return PARSER_SYNTAX;
     }
-    clause->name = strdup(token->text);
-    if (!clause->name) err(1, "malloc");
+    clause->name = arenaStrdup(parser->arena, token->text);
     parser->offset++;
 
     enum ParserResult result = parseLinebreak(parser);
-    if (result != PARSER_MATCH) goto syntax;
+    if (result != PARSER_MATCH) return PARSER_SYNTAX;
 
     token = getToken(parser);
-    if (!token) goto syntax;
+    if (!token) return PARSER_SYNTAX;
     if (strcmp(token->text, "in") == 0) {
         parser->offset++;
         token = getToken(parser);
-        if (!token) goto syntax;
+        if (!token) return PARSER_SYNTAX;
         while (token->type == TOKEN) {
-            char* word = strdup(token->text);
-            if (!word) err(1, "malloc");
-            addToArray((void**) &clause->words, &clause->numWords, &word,
-                    sizeof(char*));
+            struct Word* word = copyWord(parser, token);
+            arenaAddToArray(parser->arena, (void**) &clause->words,
+                    &clause->numWords, &word, sizeof(struct Word*));
             parser->offset++;
             token = getToken(parser);
-            if (!token) goto syntax;
+            if (!token) return PARSER_SYNTAX;
         }
         if (strcmp(token->text, ";") == 0) {
             parser->offset++;
         } else if (strcmp(token->text, "\n") != 0) {
-            goto syntax;
+            return PARSER_SYNTAX;
         }
     } else {
-        const char* word = strdup("\"$@\"");
-        if (!word) err(1, "malloc");
-        addToArray((void**) &clause->words, &clause->numWords, &word,
-                sizeof(char*));
+        struct Word* word = lexWord(parser->arena, "\"$@\"", false, NULL);
+        arenaAddToArray(parser->arena, (void**) &clause->words,
+                &clause->numWords, &word, sizeof(struct Word*));
         if (strcmp(token->text, ";") == 0) {
             parser->offset++;
         }
     }
     result = parseLinebreak(parser);
-    if (result != PARSER_MATCH) goto syntax;
+    if (result != PARSER_MATCH) return PARSER_SYNTAX;
 
     token = getToken(parser);
-    if (!token || strcmp(token->text, "do") != 0) goto syntax;
+    if (!token || strcmp(token->text, "do") != 0) return PARSER_SYNTAX;
     parser->offset++;
     result = parseCompoundListWithTerminator(parser, &clause->body, "done");
     if (result == PARSER_MATCH) return PARSER_MATCH;
-
-syntax:
-    free(clause->name);
-    for (size_t i = 0; i < clause->numWords; i++) {
-        free(clause->words[i]);
-    }
-    free(clause->words);
     return PARSER_SYNTAX;
 }
 
@@ -613,25 +594,23 @@ static enum ParserResult parseFunctionDefinition(struct Parser* parser,
     struct Function* func = malloc(sizeof(struct Function));
     if (!func) err(1, "malloc");
     func->refcount = 1;
+    initArena(&func->arena);
 
     struct Token* token = getToken(parser);
     assert(token);
-    func->name = strdup(token->text);
-    if (!func->name) err(1, "strdup");
+    func->name = arenaStrdup(&func->arena, token->text);
 
     parser->offset += 2;
     token = getToken(parser);
     if (!token || strcmp(token->text, ")") != 0) {
-        free(func->name);
-        free(func);
+        freeFunction(func);
         return PARSER_SYNTAX;
     }
 
     parser->offset++;
     enum ParserResult result = parseLinebreak(parser);
     if (result != PARSER_MATCH) {
-        free(func->name);
-        free(func);
+        freeFunction(func);
         return result;
     }
 
@@ -639,18 +618,22 @@ static enum ParserResult parseFunctionDefinition(struct Parser* parser,
     // Make sure that the function body is a compound command.
     if (!token || (!isReservedWord(token->text) &&
             strcmp(token->text, "(") != 0)) {
-        free(func->name);
-        free(func);
+        freeFunction(func);
         return PARSER_SYNTAX;
     }
 
+    // The function can outlive the command that defined it, so it gets its
+    // own arena.
+    struct Arena* arena = parser->arena;
+    parser->arena = &func->arena;
     result = parseCommand(parser, &func->body);
+    parser->arena = arena;
     if (result != PARSER_MATCH) {
-        free(func->name);
-        free(func);
+        freeFunction(func);
         return result;
     }
 
+    arenaDefer(parser->arena, releaseFunction, func);
     *function = func;
     return PARSER_MATCH;
 }
@@ -659,29 +642,29 @@ static enum ParserResult parseCaseClause(struct Parser* parser,
         struct CaseClause* clause) {
     clause->items = NULL;
     clause->numItems = 0;
+    clause->patterns = NULL;
     parser->offset++;
     struct Token* token = getToken(parser);
     if (!token || token->type != TOKEN) {
         return PARSER_SYNTAX;
     }
-    clause->word = strdup(token->text);
-    if (!clause->word) err(1, "malloc");
+    clause->word = copyWord(parser, token);
     parser->offset++;
 
     enum ParserResult result = parseLinebreak(parser);
-    if (result != PARSER_MATCH) goto syntax;
+    if (result != PARSER_MATCH) return PARSER_SYNTAX;
 
     token = getToken(parser);
     if (!token || strcmp(token->text, "in") != 0) {
-        goto syntax;
+        return PARSER_SYNTAX;
     }
     parser->offset++;
 
     result = parseLinebreak(parser);
-    if (result != PARSER_MATCH) goto syntax;
+    if (result != PARSER_MATCH) return PARSER_SYNTAX;
 
     token = getToken(parser);
-    if (!token) goto syntax;
+    if (!token) return PARSER_SYNTAX;
 
     while (strcmp(token->text, "esac") != 0) {
         struct CaseItem item;
@@ -691,26 +674,25 @@ static enum ParserResult parseCaseClause(struct Parser* parser,
         item.fallthrough = false;
 
         if (token->type != TOKEN) {
-            if (strcmp(token->text, "(") != 0) goto syntax;
+            if (strcmp(token->text, "(") != 0) return PARSER_SYNTAX;
             parser->offset++;
             token = getToken(parser);
-            if (!token) goto syntax;
+            if (!token) return PARSER_SYNTAX;
         }
 
         while (true) {
-            if (token->type != TOKEN) goto fail;
-            char* pattern = strdup(token->text);
-            if (!pattern) err(1, "malloc");
-            addToArray((void**) &item.patterns, &item.numPatterns, &pattern,
-                    sizeof(char*));
+            if (token->type != TOKEN) return PARSER_SYNTAX;
+            struct Word* pattern = copyWord(parser, token);
+            arenaAddToArray(parser->arena, (void**) &item.patterns,
+                    &item.numPatterns, &pattern, sizeof(struct Word*));
             parser->offset++;
             token = getToken(parser);
-            if (!token) goto fail;
+            if (!token) return PARSER_SYNTAX;
 
             if (token->type == OPERATOR && strcmp(token->text, "|") == 0) {
                 parser->offset++;
                 token = getToken(parser);
-                if (!token) goto fail;
+                if (!token) return PARSER_SYNTAX;
             } else {
                 break;
             }
@@ -718,24 +700,24 @@ static enum ParserResult parseCaseClause(struct Parser* parser,
 
         if (token->type != OPERATOR || strcmp(token->text, ")") != 0 ||
                 item.numPatterns == 0) {
-            goto fail;
+            return PARSER_SYNTAX;
         }
         parser->offset++;
         result = parseLinebreak(parser);
-        if (result != PARSER_MATCH) goto fail;
+        if (result != PARSER_MATCH) return PARSER_SYNTAX;
         token = getToken(parser);
-        if (!token) goto fail;
+        if (!token) return PARSER_SYNTAX;
 
         if (strcmp(token->text, "esac") != 0 &&
                 strcmp(token->text, ";;") != 0 &&
                 strcmp(token->text, ";&") != 0) {
             result = parseList(parser, &item.list, true, true);
-            if (result != PARSER_MATCH) goto fail;
+            if (result != PARSER_MATCH) return PARSER_SYNTAX;
             item.hasList = true;
         }
 
         token = getToken(parser);
-        if (!token) goto fail;
+        if (!token) return PARSER_SYNTAX;
 
         if (token->type == OPERATOR) {
             if (strcmp(token->text, ";;") == 0) {
@@ -744,44 +726,23 @@ static enum ParserResult parseCaseClause(struct Parser* parser,
                 item.fallthrough = true;
                 parser->offset++;
             } else {
-                goto fail;
+                return PARSER_SYNTAX;
             }
 
             result = parseLinebreak(parser);
-            if (result != PARSER_MATCH) goto fail;
+            if (result != PARSER_MATCH) return PARSER_SYNTAX;
             token = getToken(parser);
-            if (!token) goto fail;
+            if (!token) return PARSER_SYNTAX;
         } else if (strcmp(token->text, "esac") != 0) {
-            goto fail;
+            return PARSER_SYNTAX;
         }
 
-        addToArray((void**) &clause->items, &clause->numItems, &item,
-                sizeof(struct CaseItem));
-
-        continue;
-fail:
-        free(item.patterns);
-        if (item.hasList) {
-            freeList(&item.list);
-        }
-        goto syntax;
+        arenaAddToArray(parser->arena, (void**) &clause->items,
+                &clause->numItems, &item, sizeof(struct CaseItem));
     }
     parser->offset++;
+    clause->patterns = createCasePatterns(parser->arena, clause);
     return PARSER_MATCH;
-
-syntax:
-    for (size_t i = 0; i < clause->numItems; i++) {
-        for (size_t j = 0; j < clause->items[i].numPatterns; j++) {
-            free(clause->items[i].patterns[j]);
-        }
-        free(clause->items[i].patterns);
-        if (clause->items[i].hasList) {
-            freeList(&clause->items[i].list);
-        }
-    }
-    free(clause->items);
-    free(clause->word);
-    return PARSER_SYNTAX;
 }
 
 static enum ParserResult parseIfClause(struct Parser* parser,
@@ -789,6 +750,7 @@ static enum ParserResult parseIfClause(struct Parser* parser,
     clause->numConditions = 0;
     clause->conditions = NULL;
     clause->bodies = NULL;
+    size_t numBodies = 0;
 
     struct Token* token;
     enum ParserResult result;
@@ -796,34 +758,17 @@ static enum ParserResult parseIfClause(struct Parser* parser,
         parser->offset++;
         struct List condition;
         result = parseCompoundListWithTerminator(parser, &condition, "then");
-        if (result != PARSER_MATCH) goto fail;
+        if (result != PARSER_MATCH) return result;
         struct List body;
         result = parseList(parser, &body, true, true);
-        if (result != PARSER_MATCH) {
-            freeList(&condition);
-            goto fail;
-        }
+        if (result != PARSER_MATCH) return result;
         token = getToken(parser);
-        if (!token) {
-            result = PARSER_SYNTAX;
-            freeList(&condition);
-            freeList(&body);
-            goto fail;
-        }
-
-        struct List* newLists = reallocarray(clause->conditions,
-                clause->numConditions + 1, sizeof(struct List));
-        if (!newLists) err(1, "realloc");
-
-        clause->conditions = newLists;
-        clause->conditions[clause->numConditions] = condition;
-        newLists = reallocarray(clause->bodies, clause->numConditions + 1,
-                sizeof(struct List));
-        if (!newLists) err(1, "realloc");
+        if (!token) return PARSER_SYNTAX;
 
-        clause->bodies = newLists;
-        clause->bodies[clause->numConditions] = body;
-        clause->numConditions++;
+        arenaAddToArray(parser->arena, (void**) &clause->conditions,
+                &clause->numConditions, &condition, sizeof(struct List));
+        arenaAddToArray(parser->arena, (void**) &clause->bodies, &numBodies,
+                &body, sizeof(struct List));
     } while (strcmp(token->text, "elif") == 0);
 
     if (strcmp(token->text, "else") == 0) {
@@ -831,32 +776,15 @@ static enum ParserResult parseIfClause(struct Parser* parser,
         clause->hasElse = true;
         struct List body;
         result = parseCompoundListWithTerminator(parser, &body, "fi");
-        if (result != PARSER_MATCH) {
-            goto fail;
-        }
-        struct List* newLists = reallocarray(clause->bodies,
-                clause->numConditions + 1, sizeof(struct List));
-        if (!newLists) err(1, "realloc");
-        clause->bodies = newLists;
-        clause->bodies[clause->numConditions] = body;
+        if (result != PARSER_MATCH) return result;
+        arenaAddToArray(parser->arena, (void**) &clause->bodies, &numBodies,
+                &body, sizeof(struct List));
     } else {
-        if (strcmp(token->text, "fi") != 0) {
-            result = PARSER_SYNTAX;
-            goto fail;
-        }
+        if (strcmp(token->text, "fi") != 0) return PARSER_SYNTAX;
         clause->hasElse = false;
         parser->offset++;
     }
     return PARSER_MATCH;
-
-fail:
-    for (size_t i = 0; i < clause->numConditions; i++) {
-        freeList(&clause->conditions[i]);
-        freeList(&clause->bodies[i]);
-    }
-    free(clause->conditions);
-    free(clause->bodies);
-    return result;
 }
 
 static enum ParserResult parseLinebreak(struct Parser* parser) {
@@ -869,7 +797,7 @@ static enum ParserResult parseLinebreak(struct Parser* parser) {
         if (!token) {
             enum TokenizerResult tokenResult = splitTokens(&parser->tokenizer);
             if (tokenResult == TOKENIZER_PREMATURE_EOF) {
-                syntaxError(NULL);
+                syntaxError(parser, NULL);
                 return PARSER_SYNTAX;
             } else if (tokenResult == TOKENIZER_SYNTAX_ERROR) {
                 return PARSER_SYNTAX;
@@ -880,8 +808,10 @@ static enum ParserResult parseLinebreak(struct Parser* parser) {
     return PARSER_MATCH;
 }
 
-static void syntaxError(struct Token* token) {
-    if (!token) {
+static void syntaxError(struct Parser* parser, struct Token* token) {
+    if (parser->tokenizer.quiet) {
+        return;
+    } else if (!token) {
         warnx("syntax error: unexpected end of file");
     } else if (strcmp(token->text, "\n") == 0) {
         warnx("syntax error: unexpected newline");
@@ -891,7 +821,7 @@ static void syntaxError(struct Token* token) {
 }
 
 void freeCompleteCommand(struct CompleteCommand* command) {
-    freeList(&command->list);
+    freeArena(&command->arena);
     if (command->prevCommand) {
         freeCompleteCommand(command->prevCommand);
     }
@@ -899,101 +829,11 @@ void freeCompleteCommand(struct CompleteCommand* command) {
 
 void freeFunction(struct Function* function) {
     if (--function->refcount == 0) {
-        free(function->name);
-        freeCommand(&function->body);
+        freeArena(&function->arena);
         free(function);
     }
 }
 
-static void freeList(struct List* list) {
-    for (size_t i = 0; i < list->numPipelines; i++) {
-        freePipeline(&list->pipelines[i]);
-    }
-    free(list->pipelines);
-    free(list->separators);
-}
-
-static void freePipeline(struct Pipeline* pipeline) {
-    for (size_t i = 0; i < pipeline->numCommands; i++) {
-        freeCommand(&pipeline->commands[i]);
-    }
-    free(pipeline->commands);
-}
-
-static void freeCommand(struct Command* command) {
-    switch (command->type) {
-    case COMMAND_SIMPLE:
-        freeSimpleCommand(&command->simpleCommand);
-        break;
-    case COMMAND_SUBSHELL:
-    case COMMAND_BRACE_GROUP:
-        freeList(&command->compoundList);
-        break;
-    case COMMAND_FOR:
-        free(command->forClause.name);
-        for (size_t i = 0; i < command->forClause.numWords; i++) {
-            free(command->forClause.words[i]);
-        }
-        free(command->forClause.words);
-        freeList(&command->forClause.body);
-        break;
-    case COMMAND_CASE:
-        for (size_t i = 0; i < command->caseClause.numItems; i++) {
-            for (size_t j = 0; j < command->caseClause.items[i].numPatterns; j++) {
-                free(command->caseClause.items[i].patterns[j]);
-            }
-            free(command->caseClause.items[i].patterns);
-            if (command->caseClause.items[i].hasList) {
-                freeList(&command->caseClause.items[i].list);
-            }
-        }
-        free(command->caseClause.items);
-        free(command->caseClause.word);
-        break;
-    case COMMAND_IF:
-        for (size_t i = 0; i < command->ifClause.numConditions; i++) {
-            freeList(&command->ifClause.conditions[i]);
-            freeList(&command->ifClause.bodies[i]);
-        }
-        if (command->ifClause.hasElse) {
-            freeList(&command->ifClause.bodies[
-                    command->ifClause.numConditions]);
-        }
-        free(command->ifClause.conditions);
-        free(command->ifClause.bodies);
-        break;
-    case COMMAND_WHILE:
-    case COMMAND_UNTIL:
-        freeList(&command->loop.condition);
-        freeList(&command->loop.body);
-        break;
-    case COMMAND_FUNCTION_DEFINITION:
-        freeFunction(command->function);
-        break;
-    }
-
-    for (size_t i = 0; i < command->numRedirections; i++) {
-        freeRedirection(&command->redirections[i]);
-    }
-    free(command->redirections);
-}
-
-static void freeSimpleCommand(struct SimpleCommand* command) {
-    for (size_t i = 0; i < command->numAssignmentWords; i++) {
-        free(command->assignmentWords[i]);
-    }
-    for (size_t i = 0; i < command->numRedirections; i++) {
-        freeRedirection(&command->redirections[i]);
-    }
-    for (size_t i = 0; i < command->numWords; i++) {
-        free(command->words[i]);
-    }
-
-    free(command->assignmentWords);
-    free(command->redirections);
-    free(command->words);
-}
-
-static void freeRedirection(struct Redirection* redirection) {
-    free(redirection->filename);
+static void releaseFunction(void* function) {
+    freeFunction(function);
 }
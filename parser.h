@@ -1,4 +1,4 @@
-/* Copyright (c) 2018, 2019, 2020, 2021, 2022, 2025 Dennis Wölfing
+/* Copyright (c) 2018, 2019, 2020, 2021, 2022, 2025, 2026 Dennis Wölfing
  *
  * Permission to use, copy, modify, and/or distribute this software for any
  * purpose with or without fee is hereby granted, provided that the above
@@ -23,8 +23,11 @@
 #include <stdbool.h>
 #include <stddef.h>
 
+#include "arena.h"
 #include "tokenizer.h"
 
+struct Word;
+
 enum {
     REDIR_INPUT,
     REDIR_OUTPUT,
@@ -39,15 +42,18 @@ enum {
 struct Redirection {
     int fd;
     int type;
+    // The word that is expanded to the filename or here-document contents.
+    // It is NULL for quoted here-documents.
+    struct Word* word;
     char* filename; // or here-document contents
 };
 
 struct SimpleCommand {
-    char** assignmentWords;
+    struct Word** assignmentWords;
     size_t numAssignmentWords;
     struct Redirection* redirections;
     size_t numRedirections;
-    char** words;
+    struct Word** words;
     size_t numWords;
 };
 
@@ -64,7 +70,7 @@ enum {
 };
 
 struct CaseItem {
-    char** patterns;
+    struct Word** patterns;
     size_t numPatterns;
     struct List list;
     bool hasList;
@@ -72,14 +78,15 @@ struct CaseItem {
 };
 
 struct CaseClause {
-    char* word;
+    struct Word* word;
     struct CaseItem* items;
     size_t numItems;
+    struct CasePatterns* patterns;
 };
 
 struct ForClause {
     char* name;
-    char** words;
+    struct Word** words;
     size_t numWords;
     struct List body;
 };
@@ -128,6 +135,7 @@ struct Function {
     char* name;
     size_t refcount;
     struct Command body;
+    struct Arena arena;
 };
 
 struct Pipeline {
@@ -139,12 +147,15 @@ struct Pipeline {
 struct CompleteCommand {
     struct List list;
     struct CompleteCommand* prevCommand;
+    struct Arena arena;
 };
 
 struct Parser {
     struct Tokenizer tokenizer;
     size_t offset;
     size_t hereDocOffset;
+    // The syntax tree is allocated in this arena.
+    struct Arena* arena;
 };
 
 enum ParserResult {
@@ -157,8 +168,8 @@ enum ParserResult {
 
 void freeParser(struct Parser* parser);
 void initParser(struct Parser* parser,
-        bool (*readInput)(const char** str, bool newCommand, void* context),
-        void* context);
+        bool (*readInput)(const char** str, size_t* length, bool newCommand,
+        void* context), void* context);
 bool isReservedWord(const char* word);
 enum ParserResult parse(struct Parser* parser,
         struct CompleteCommand* command, bool readWholeScript);
@@ -1,4 +1,4 @@
-/* Copyright (c) 2018, 2019, 2020, 2022, 2025 Dennis Wölfing
+/* Copyright (c) 2018, 2019, 2020, 2022, 2025, 2026 Dennis Wölfing
  *
  * Permission to use, copy, modify, and/or distribute this software for any
  * purpose with or without fee is hereby granted, provided that the above
@@ -19,42 +19,78 @@
 
 #include <config.h>
 #include <err.h>
+#include <errno.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "stringbuffer.h"
 
 void initStringBuffer(struct StringBuffer* buffer) {
-    buffer->buffer = malloc(80);
-    if (!buffer->buffer) err(1, "malloc");
+    buffer->buffer = buffer->inlineBuffer;
     buffer->used = 0;
-    buffer->allocated = 80;
+    buffer->allocated = STRINGBUFFER_INLINE_SIZE;
 }
 
 void appendToStringBuffer(struct StringBuffer* buffer, char c) {
     if (buffer->used + 1 >= buffer->allocated) {
-        void* newBuffer = reallocarray(buffer->buffer, 2, buffer->allocated);
-        if (!newBuffer) err(1, "realloc");
-        buffer->buffer = newBuffer;
-        buffer->allocated *= 2;
+        reserveStringBuffer(buffer, 1);
     }
     buffer->buffer[buffer->used++] = c;
 }
 
 void appendBytesToStringBuffer(struct StringBuffer* buffer, const char* s,
         size_t length) {
-    for (size_t i = 0; i < length; i++) {
-        appendToStringBuffer(buffer, s[i]);
-    }
+    reserveStringBuffer(buffer, length);
+    memcpy(buffer->buffer + buffer->used, s, length);
+    buffer->used += length;
 }
 
 void appendStringToStringBuffer(struct StringBuffer* buffer, const char* s) {
-    while (*s) {
-        appendToStringBuffer(buffer, *s);
-        s++;
-    }
+    appendBytesToStringBuffer(buffer, s, strlen(s));
 }
 
 char* finishStringBuffer(struct StringBuffer* buffer) {
+    if (buffer->buffer == buffer->inlineBuffer) {
+        char* result = malloc(buffer->used + 1);
+        if (!result) err(1, "malloc");
+        memcpy(result, buffer->inlineBuffer, buffer->used);
+        result[buffer->used] = '\0';
+        return result;
+    }
+
     buffer->buffer[buffer->used] = '\0';
     return buffer->buffer;
 }
+
+void freeStringBuffer(struct StringBuffer* buffer) {
+    if (buffer->buffer != buffer->inlineBuffer) {
+        free(buffer->buffer);
+    }
+}
+
+// Makes room for length more bytes and the terminating null byte.
+void reserveStringBuffer(struct StringBuffer* buffer, size_t length) {
+    if (length < buffer->allocated - buffer->used) return;
+
+    size_t newSize = buffer->allocated;
+    while (length >= newSize - buffer->used) {
+        if (newSize > SIZE_MAX / 2) {
+            errno = ENOMEM;
+            err(1, "realloc");
+        }
+        newSize *= 2;
+    }
+
+    if (buffer->buffer == buffer->inlineBuffer) {
+        char* newBuffer = malloc(newSize);
+        if (!newBuffer) err(1, "malloc");
+        memcpy(newBuffer, buffer->inlineBuffer, buffer->used);
+        buffer->buffer = newBuffer;
+    } else {
+        char* newBuffer = realloc(buffer->buffer, newSize);
+        if (!newBuffer) err(1, "realloc");
+        buffer->buffer = newBuffer;
+    }
+    buffer->allocated = newSize;
+}
@@ -1,4 +1,4 @@
-/* Copyright (c) 2018, 2019, 2020, 2022, 2025 Dennis Wölfing
+/* Copyright (c) 2018, 2019, 2020, 2022, 2025, 2026 Dennis Wölfing
  *
  * Permission to use, copy, modify, and/or distribute this software for any
  * purpose with or without fee is hereby granted, provided that the above
@@ -23,10 +23,15 @@
 #include <stdbool.h>
 #include <stddef.h>
 
+// Short strings are kept in the inline buffer and are only moved to the heap
+// when they outgrow it, so a StringBuffer must not be copied.
+#define STRINGBUFFER_INLINE_SIZE 64
+
 struct StringBuffer {
     char* buffer;
     size_t used;
     size_t allocated;
+    char inlineBuffer[STRINGBUFFER_INLINE_SIZE];
 };
 
 void initStringBuffer(struct StringBuffer* buffer);
@@ -35,5 +40,7 @@ void appendBytesToStringBuffer(struct StringBuffer* buffer, const char* s,
         size_t length);
 void appendStringToStringBuffer(struct StringBuffer* buffer, const char* s);
 char* finishStringBuffer(struct StringBuffer* buffer);
+void freeStringBuffer(struct StringBuffer* buffer);
+void reserveStringBuffer(struct StringBuffer* buffer, size_t length);
 
 #endif
@@ -1,4 +1,4 @@
-# Copyright (c) 2025 Dennis Wölfing
+# Copyright (c) 2025, 2026 Dennis Wölfing
 #
 # Permission to use, copy, modify, and/or distribute this software for any
 # purpose with or without fee is hereby granted, provided that the above
@@ -235,6 +235,21 @@ foo loaded
 foo called: Hello
 bar called: Variable set by bar script
 EOF
+# Sourcing the same file repeatedly, recursively and after it was modified.
+test_shell_succeed << "EOF"
+echo 'echo sourced $level; if test "$level" != xx; then level=x$level; . ./foo; fi' > foo
+. ./foo
+. ./foo
+echo 'echo modified' > foo
+. ./foo
+EOF
+assert_output << EOF
+sourced
+sourced x
+sourced xx
+sourced xx
+modified
+EOF
 rm -f foo bar
 
 test_case 'builtins:special:eval'
@@ -256,6 +271,21 @@ assert_output << EOF
 Hello World
 42
 EOF
+# Evaluating the same string repeatedly and recursively.
+test_shell_succeed << "EOF"
+cmd='echo eval $level; if test "$level" != xx; then level=x$level; eval "$cmd"; fi'
+eval "$cmd"
+eval "$cmd"
+for i in 1 2; do eval 'f() { echo f $i; }; f'; done
+EOF
+assert_output << EOF
+eval
+eval x
+eval xx
+eval xx
+f 1
+f 2
+EOF
 
 test_case 'builtins:special:exec'
 assert_special_builtin exec
@@ -434,6 +464,40 @@ trapped 0
 will now exit
 exit trap 0
 EOF
+# A trap that changes itself while it is executed.
+test_shell_succeed << "EOF"
+trap 'echo first; trap "echo second" USR1' USR1
+kill -s USR1 $$
+kill -s USR1 $$
+kill -s USR1 $$
+EOF
+assert_output << EOF
+first
+second
+second
+EOF
+if test_shell_is_dxsh; then
+# trap -c parses the action immediately and keeps the old trap on errors.
+test_shell << "EOF" >test_stdout 2>test_stderr
+trap -c 'echo checked' USR1
+echo status $?
+trap
+kill -s USR1 $$
+trap -c 'echo (' USR1
+echo status $?
+trap
+kill -s USR1 $$
+EOF
+assert_output << "EOF"
+status 0
+trap -- 'echo checked' USR1
+checked
+status 1
+trap -- 'echo checked' USR1
+checked
+EOF
+grep -q "syntax error" test_stderr || fail_test "syntax error was not reported"
+fi
 
 test_case 'builtins:special:unset'
 assert_special_builtin unset "unset unset_var"
@@ -571,6 +635,32 @@ assert_output << "EOF"
 abc
 [abc def][]
 EOF
+# The shell must not consume input beyond the current command when reading
+# commands from standard input.
+cat > file << "EOF"
+read line
+data line
+echo "[$line]"
+x=1; : "$x"
+f() { read line; }
+f
+function data
+echo "[$line]"
+{ cat; } </dev/null
+echo "[$(head -n 1)]"
+substitution data
+cat
+echo end
+remaining input
+EOF
+test_shell_succeed < file
+assert_output << "EOF"
+[data line]
+[function data]
+[substitution data]
+echo end
+remaining input
+EOF
 rm -f file
 
 test_case 'builtins:intrinsic:umask'
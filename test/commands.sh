@@ -1,4 +1,4 @@
-# Copyright (c) 2025 Dennis Wölfing
+# Copyright (c) 2025, 2026 Dennis Wölfing
 #
 # Permission to use, copy, modify, and/or distribute this software for any
 # purpose with or without fee is hereby granted, provided that the above
@@ -83,6 +83,40 @@ function now a function is called
 EOF
 rm -rf foo bar
 
+test_case 'commands:simple:utility'
+mkdir bin
+# Files without #! are executed as shell scripts.
+echo 'echo "prog $1 ${var-unset}"' > bin/prog
+echo 'echo not executable' > noexec
+chmod +x bin/prog
+test_shell << "EOF" >test_stdout 2>test_stderr
+bin/prog direct
+PATH="$(pwd)/bin:$PATH" prog path
+prog path_not_kept
+echo status $?
+var=assigned bin/prog environment
+echo "${var-unset}"
+./noexec
+echo status $?
+nonexistent_command
+echo status $?
+bin/prog redirected >file
+echo restored
+cat file
+EOF
+assert_output << "EOF"
+prog direct unset
+prog path unset
+status 127
+prog environment assigned
+unset
+status 126
+status 127
+restored
+prog redirected unset
+EOF
+rm -rf bin noexec file
+
 test_case 'commands:pipeline'
 test_shell_succeed << "EOF"
 echo World | { echo Hello; cat; }
@@ -151,6 +185,17 @@ y
 b
 EOF
 
+test_case 'commands:list:last_command'
+test_shell_succeed -c 'trap "echo exit trap" EXIT; echo last'
+assert_output << EOF
+last
+exit trap
+EOF
+test_shell -c 'true && if true; then { (exit 3); } 2>&1; fi'; exit_status=$?
+test $exit_status = 3 || fail_test "exited with $exit_status"
+test_shell -c '! sh -c "exit 3"'; exit_status=$?
+test $exit_status = 0 || fail_test "negated command exited with $exit_status"
+
 test_case 'commands:compound:subshell'
 test_shell_succeed << "EOF"
 var=x
@@ -252,6 +297,25 @@ b
 all
 EOF
 
+test_case 'commands:compound:case_order'
+test_shell_succeed << "EOF"
+for word in foo bar baz qux x; do
+    case $word in
+        x|foo) echo literal $word;;
+        b*) echo pattern $word;;
+        bar|baz|qux) echo late $word;;
+        qux) echo duplicate;;
+    esac
+done
+EOF
+assert_output << EOF
+literal foo
+pattern bar
+pattern baz
+late qux
+literal x
+EOF
+
 test_case 'commands:compound:if'
 test_shell_succeed << "EOF"
 if true; then
@@ -365,4 +429,56 @@ function again
 EOF
 rm -f foo
 
+if test_shell_is_dxsh; then
+test_case 'commands:compiled_script'
+cat > script << "EOF"
+greet() {
+    echo "Hello $1"
+}
+for arg; do
+    case $arg in
+    [0-9]*) echo "number $((arg * 2))" ;;
+    *) greet "$arg" ;;
+    esac
+done
+cat << END
+$# arguments, $(echo substituted)
+END
+cat << 'END'
+$# is not expanded
+END
+EOF
+test_shell_succeed --compile script -o script.dxc
+test_shell_succeed script.dxc World 21
+assert_output << "EOF"
+Hello World
+number 42
+2 arguments, substituted
+$# is not expanded
+EOF
+
+size=$(wc -c < script.dxc)
+cp script.dxc broken.dxc
+printf '\002' | dd of=broken.dxc bs=1 seek=4 conv=notrunc 2>/dev/null
+test_shell_fail broken.dxc
+grep -q "unsupported compiled script version 2" test_stderr ||
+        fail_test "wrong version was not rejected"
+cp script.dxc broken.dxc
+printf 'x' | dd of=broken.dxc bs=1 seek=$((size - 2)) conv=notrunc \
+        2>/dev/null
+test_shell_fail broken.dxc
+grep -q "compiled script is corrupted" test_stderr ||
+        fail_test "wrong checksum was not rejected"
+dd if=script.dxc of=broken.dxc bs=1 count=$((size - 1)) 2>/dev/null
+test_shell_fail broken.dxc
+grep -q "compiled script is corrupted" test_stderr ||
+        fail_test "truncated payload was not rejected"
+dd if=script.dxc of=broken.dxc bs=1 count=10 2>/dev/null
+test_shell_fail broken.dxc
+grep -q "invalid compiled script" test_stderr ||
+        fail_test "truncated header was not rejected"
+test -s test_stdout && fail_test "broken script produced output"
+rm -f script script.dxc broken.dxc
+fi
+
 end_test_set
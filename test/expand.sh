@@ -16,7 +16,7 @@
 
 # Tests for POSIX XSH 2.6 Word Expansions.
 
-# TODO: Tilde expansion, arithmetic expansion
+# TODO: Tilde expansion
 
 test_case 'expand:parameter:simple'
 test_shell_succeed << "EOF"
@@ -25,10 +25,12 @@ empty_var=
 unset -v unset_var
 echo $set_var ${empty_var}
 echo $set_var${unset_var}x
+echo $set_var$ "$set_var$"
 EOF
 assert_output << EOF
 x
 xx
+x$ x$
 EOF
 
 test_case 'expand:parameter:default'
@@ -144,6 +146,8 @@ echo ${var%%ba}
 echo ${var#ab}
 echo ${var##ab}
 echo ${var%x}
+unset -v var
+echo "[${var%x}]" "[${var##*}]"
 EOF
 assert_output << EOF
 ababa
@@ -151,6 +155,7 @@ ababa
 ababa
 ababa
 abababa
+[] []
 EOF
 # Non-trivial patterns are tested in pattern.sh
 
@@ -203,6 +208,112 @@ y x
 match abc)
 EOF
 
+test_case 'expand:command:repeated'
+test_shell_succeed << "EOF"
+f() {
+    echo "$(echo "$1") `echo "$1"`" '`echo quoted`' \`echo escaped\`
+}
+for i in 1 2 3; do
+    f $i
+done
+if false; then
+    echo `echo (`
+fi
+echo done
+EOF
+assert_output << EOF
+1 1 \`echo quoted\` \`echo escaped\`
+2 2 \`echo quoted\` \`echo escaped\`
+3 3 \`echo quoted\` \`echo escaped\`
+done
+EOF
+
+test_case 'expand:command:subshell'
+test_shell_succeed << "EOF"
+var=outer
+f() {
+    var=inner
+    umask 077
+    command -v f
+}
+umask 022
+result=$(f; : ${unset=assigned})
+printf '%s %s %s %s\n' "$result" "$var" "${unset-unset}" "$(umask)"
+for i in 1 2; do
+    result=$(break)
+    printf '%s\n' "$i"
+done
+EOF
+assert_output << EOF
+f outer unset 0022
+1
+2
+EOF
+
+test_case 'expand:command:utility'
+test_shell << "EOF" >test_stdout 2>test_stderr
+unset var
+result=$(printf '%s\n' ${var=x})
+echo "$result ${var-unset}"
+result=$(cat 2>/dev/null </nonexistent)
+echo status $?
+result=$(nonexistent_command)
+echo status $?
+cat() {
+    echo function
+}
+echo "$(cat /dev/null)"
+EOF
+assert_output << "EOF"
+x unset
+status 1
+status 127
+function
+EOF
+
+test_case 'expand:arithmetic'
+test_shell_succeed << "EOF"
+x=5
+empty=
+unset -v unset_var
+echo $((1 + 2 * 3)) $(( (1 + 2) * 3 )) $((-7 / 2)) $((7 % 3)) $((2 << 3))
+echo $((0x1f)) $((010)) $((~0)) $((!x)) $((x > 3 && x < 10)) $((0 || 0))
+echo $((x ? 10 : 20)) $((empty + unset_var)) $(($x$x)) "$(( $(echo 6) * 7 ))"
+echo $((x += 2)) $x $((x *= 3)) $((x /= 2)) $((x %= 4)) $((y = x = 9)) $y
+echo $((0 && (z = 1))) ${z-unset} $((0x7fffffffffffffff + 1))
+i=0
+while [ $i -lt 3 ]; do
+    i=$((i + 1))
+done
+echo $i "$((1))$((2))" a$((3))b
+result=$(: $((n = 5)))
+echo ${n-unset}
+EOF
+assert_output << EOF
+7 9 -3 1 16
+31 8 -1 0 1 0
+10 0 55 42
+7 7 21 10 2 9 9
+0 unset -9223372036854775808
+3 12 a3b
+unset
+EOF
+
+test_case 'expand:arithmetic:error'
+test_shell >test_stdout 2>test_stderr << "EOF"
+echo $((1 / 0)) || echo division
+echo $((1 +)) || echo syntax
+x=abc
+echo $((x + 1)) || echo number
+EOF
+assert_output << EOF
+division
+syntax
+number
+EOF
+grep -q "division by zero" test_stderr || fail_test 'No error for division by zero'
+grep -q "abc" test_stderr || fail_test 'No error for invalid variable value'
+
 test_case 'expand:field_split'
 test_shell_succeed << "EOF"
 var=" a  b	c
@@ -266,4 +377,33 @@ d ]
 [][][a][b]
 EOF
 
+test_case 'expand:field_split:long'
+test_shell_succeed << "EOF"
+var="abcdefghijklmnopqrstuvwxyz0123456789:abcdefghijklmnopqrstuvwxyz0123 5"
+printf '[%s]' $var
+printf '\n'
+IFS=:
+printf '[%s]' $var
+printf '\n'
+IFS=':;,.- '
+var="abcdefghijklmnopqrstuvwxyz0123456789;abcdefghijklmnopqrstuvwxyz0123,5"
+printf '[%s]' $var
+printf '\n'
+EOF
+assert_output << EOF
+[abcdefghijklmnopqrstuvwxyz0123456789:abcdefghijklmnopqrstuvwxyz0123][5]
+[abcdefghijklmnopqrstuvwxyz0123456789][abcdefghijklmnopqrstuvwxyz0123 5]
+[abcdefghijklmnopqrstuvwxyz0123456789][abcdefghijklmnopqrstuvwxyz0123][5]
+EOF
+
+test_case 'expand:quote_removal'
+test_shell_succeed << "EOF"
+set -- 'a"b' "c'd" 'e\f'
+printf '[%s]' "1$@2" x"$@"y '"'$1 "\$2" a\'b'\c'
+printf '\n'
+EOF
+assert_output << "EOF"
+[1a"b][c'd][e\f2][xa"b][c'd][e\fy]["a"b][$2][a'b\c]
+EOF
+
 end_test_set
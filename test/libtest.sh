@@ -1,4 +1,4 @@
-# Copyright (c) 2025 Dennis Wölfing
+# Copyright (c) 2025, 2026 Dennis Wölfing
 #
 # Permission to use, copy, modify, and/or distribute this software for any
 # purpose with or without fee is hereby granted, provided that the above
@@ -45,6 +45,13 @@ fail_test() {
     tests_failed=true
 }
 
+# test_shell_is_dxsh
+# Return whether the test shell is dxsh. Tests for extensions of dxsh are only
+# run in that case.
+test_shell_is_dxsh() {
+    test "$(test_shell -c 'command -v dxcache' 2>/dev/null)" = dxcache
+}
+
 # test_shell_success [ARGS...]
 # Run the test shell and assert that it succeeds and produces no output to
 # stderr. Output is captured in the test_stdout file.
@@ -60,14 +60,14 @@ assert_no_match '[?]' 'x'
 assert_match '[]-_]' '^'
 assert_match '[!]]' 'x'
 assert_no_match '[!]]' ']'
-# TODO: Fails due to fnmatch bugs: assert_match '[/\]' '/'
-# TODO: Fails due to fnmatch bugs: assert_match '[/\]' '\'
+assert_match '[/\]' '/'
+assert_match '[/\]' '\'
 assert_match '[[x]' '['
 assert_match '[[:upper:]][[:punct:]]' 'A.'
 assert_no_match '[[:upper:]][[:punct:]]' 'a.'
 assert_match '[![:upper:]]' 'b'
 assert_match '[[:blank:]]' '	'
-# TODO: Fails due to fnmatch bugs: assert_match '[\[:alpha:]]' 'b'
+assert_match '[\[:alpha:]]' 'b'
 assert_match '*a' '.a'
 assert_match 'a*c' 'a/c'
 assert_match 'a[b/c]d' 'a/d'
@@ -94,9 +94,12 @@ assert_match '[[.!.][.^.]]' '^'
 assert_no_match '[[.!.][.^.]]' '!^'
 assert_no_match '[[.xyz.]]' 'x'
 assert_match '[[...]]' '.'
+# An unterminated bracket expression starts with a literal [.
+assert_no_match '[]*a' ']]xa'
+assert_match '[]*a' '[]xa'
 # TODO: Fails due to fnmatch bugs: assert_match '[![:x]:]]' 'x'
 # These patterns seem to currently break dxsh.
-# TODO: assert_match '[[.\.]]' '\'
+assert_match '[[.\.]]' '\'
 # TODO: assert_match '[[:]' '[:'
 # TODO: assert_no_match '[[:]' ':'
 # TODO: assert_no_match '[[:]' '[[:]'
@@ -196,6 +199,94 @@ check_file_expansion 'a[b/c]d' 'a[b/c]d' '!abd' '!a/d'
 check_file_expansion '*/?' 'a/b' '!c/d/e' 'c/d'
 check_file_expansion 'a\/b/*' 'a/b/c'
 check_file_expansion 'a\*c/*' 'a*c/x' '!abc/x'
+check_file_expansion '?/*/z' 'a/b/z' 'a/c/z' '!a/b/y' '!c/z'
+check_file_expansion '.*/a' '.b/a' '!.b/b' '!c/a'
+
+if test_shell_is_dxsh; then
+test_case 'pattern:pathname_expansion:globcache'
+mkdir files
+: >files/a
+: >files/b
+# Directories that were modified in the last second are not cached.
+sleep 2
+test_shell_succeed << "EOF"
+set -o globcache
+echo files/*
+echo files/*
+: >files/c
+echo files/*
+dxcache | grep '^glob:'
+EOF
+assert_output << "EOF"
+files/a files/b
+files/a files/b
+files/a files/b files/c
+glob: 1 hits, 2 misses, 0 evictions, 0/32 entries, 0 names
+EOF
+rm -rf files
+
+test_case 'pattern:pathname_expansion:workers'
+mkdir -p files/a/1 files/a/2/y files/b/1 files/b/3 files/c files/d/2
+: >files/a/1/x
+: >files/a/2/x
+: >files/b/3/x
+: >files/c/x
+: >files/d/2/x
+test_shell_succeed << "EOF"
+cd files
+for workers in 3 ''; do
+    DXSH_GLOB_WORKERS=$workers
+    echo */*/x
+    echo */*/
+    echo ?/[12]/*
+    echo c/*/x
+    echo */none*/x
+done
+EOF
+assert_output << "EOF"
+a/1/x a/2/x b/3/x d/2/x
+a/1/ a/2/ b/1/ b/3/ d/2/
+a/1/x a/2/x a/2/y d/2/x
+c/*/x
+*/none*/x
+a/1/x a/2/x b/3/x d/2/x
+a/1/ a/2/ b/1/ b/3/ d/2/
+a/1/x a/2/x a/2/y d/2/x
+c/*/x
+*/none*/x
+EOF
+rm -rf files
+
+test_case 'pattern:pathname_expansion:globstar'
+mkdir -p files/a/b/c files/.h files/a/.h
+for file in x a/x a/b/x a/b/c/x .h/x a/.h/x y a/b/y; do
+    : >"files/$file"
+done
+# Symbolic links are not followed, so this does not loop.
+ln -s .. files/a/b/loop
+test_shell_succeed << "EOF"
+cd files
+set -o globstar
+echo **/x
+echo **
+echo a/**/y
+echo **/
+echo .h/**
+set +o globstar
+echo **/x
+echo **
+EOF
+assert_output << "EOF"
+a/b/c/x a/b/x a/x x
+a a/b a/b/c a/b/c/x a/b/loop a/b/x a/b/y a/x x y
+a/b/y
+a/ a/b/ a/b/c/
+.h/x
+a/x
+a x y
+EOF
+rm -rf files
+fi
 
 test_case 'pattern:prefix_suffix_removal'
 # assert_pattern_removal VALUE PATTERN PREFIX GPREFIX SUFFIX GSUFFIX
@@ -217,14 +308,15 @@ EOF
 assert_pattern_removal x '' x x x x
 assert_pattern_removal abcacxabcxacabc 'a*c' acxabcxacabc '' abcacxabcxac ''
 assert_pattern_removal xby 'x[a-c]y' '' '' '' ''
-# TODO: Fails due to fnmatch bugs: assert_pattern_removal '/a\' '[/\\]' 'a\' 'a\' '/a' '/a'
+assert_pattern_removal '/a\' '[/\\]' 'a\' 'a\' '/a' '/a'
 assert_pattern_removal AB. '[[:upper:]][[:punct:]]' 'AB.' 'AB.' 'A' 'A'
-# TODO: Fails due to fnmatch bugs: assert_pattern_removal ab '[\\[:alpha:]]' 'b' 'b' 'a' 'a'
+assert_pattern_removal ab '[\\[:alpha:]]' 'b' 'b' 'a' 'a'
 assert_pattern_removal xy '[[.x.]]' 'y' 'y' 'xy' 'xy'
 assert_pattern_removal xyz '"x"' 'yz' 'yz' 'xyz' 'xyz'
 assert_pattern_removal 'a*' '"*"' 'a*' 'a*' 'a' 'a'
 assert_pattern_removal 'ab?' '\?' 'ab?' 'ab?' 'ab' 'ab'
 assert_pattern_removal 'ax[ab]' '[ab"]"' 'ax[ab]' 'ax[ab]' 'ax' 'ax'
+assert_pattern_removal ']]b[ab' '[]*a' ']]b[ab' ']]b[ab' ']]b[ab' ']]b[ab'
 
 
 end_test_set
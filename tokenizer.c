@@ -1,4 +1,4 @@
-/* Copyright (c) 2018, 2019, 2020, 2021, 2022, 2025 Dennis Wölfing
+/* Copyright (c) 2018, 2019, 2020, 2021, 2022, 2025, 2026 Dennis Wölfing
  *
  * Permission to use, copy, modify, and/or distribute this software for any
  * purpose with or without fee is hereby granted, provided that the above
@@ -30,58 +30,70 @@
 
 static bool canBeginOperator(char c);
 static bool canContinueOperator(const char* s, size_t opLength, char c);
+static const char* currentToken(struct Tokenizer* tokenizer, size_t* length);
 static void delimit(struct Tokenizer* tokenizer, enum TokenType type);
+static void flushToken(struct Tokenizer* tokenizer);
 static void nest(struct Tokenizer* tokenizer, enum TokenStatus status);
 static bool readHereDocument(struct Tokenizer* tokenizer);
+static bool readMoreInput(struct Tokenizer* tokenizer, bool newCommand);
+static void releaseCommand(void* command);
 static void unnest(struct Tokenizer* tokenizer);
 
 void initTokenizer(struct Tokenizer* tokenizer,
-        bool (*readInput)(const char** str, bool newCommand, void* context),
-        void* context) {
+        bool (*readInput)(const char** str, size_t* length, bool newCommand,
+        void* context), void* context) {
+    initArena(&tokenizer->arena);
     tokenizer->backslash = false;
+    tokenizer->quiet = false;
+    tokenizer->tokenStart = NULL;
+    tokenizer->substitutions = NULL;
+    tokenizer->numSubstitutions = 0;
     tokenizer->numTokens = 0;
-    tokenizer->prev = NULL;
+    tokenizer->nestedStatus = NULL;
+    tokenizer->nesting = 0;
+    tokenizer->nestedStatusSize = 0;
     tokenizer->tokens = NULL;
     tokenizer->numHereDocs = 0;
     tokenizer->hereDocs = NULL;
     tokenizer->tokenStatus = TOKEN_TOPLEVEL;
     tokenizer->wordStatus = WORDSTATUS_NONE;
     tokenizer->input = NULL;
+    tokenizer->inputEnd = NULL;
     tokenizer->readInput = readInput;
     tokenizer->context = context;
 
     initStringBuffer(&tokenizer->buffer);
 }
 
-static bool readInput(const char** str, bool newCommand, void* context) {
+static bool readInput(const char** str, size_t* length, bool newCommand,
+        void* context) {
     (void) newCommand;
     struct Tokenizer* tokenizer = context;
 
-    if (!*tokenizer->input) {
-        if (!tokenizer->readInput(&tokenizer->input, false,
+    if (tokenizer->input == tokenizer->inputEnd) {
+        size_t inputLength;
+        if (!tokenizer->readInput(&tokenizer->input, &inputLength, false,
                 tokenizer->context)) {
             return false;
         }
+        tokenizer->inputEnd = tokenizer->input + inputLength;
     }
     *str = tokenizer->input;
-    appendStringToStringBuffer(&tokenizer->buffer, tokenizer->input);
-    tokenizer->input += strlen(tokenizer->input);
+    *length = tokenizer->inputEnd - tokenizer->input;
+    appendBytesToStringBuffer(&tokenizer->buffer, tokenizer->input, *length);
+    tokenizer->input = tokenizer->inputEnd;
     return true;
 }
 
 enum TokenizerResult splitTokens(struct Tokenizer* tokenizer) {
     if (!tokenizer->input) {
-        if (!tokenizer->readInput(&tokenizer->input, true,
-                tokenizer->context)) {
-            tokenizer->input = "";
+        if (!readMoreInput(tokenizer, true)) {
             return TOKENIZER_DONE;
         }
     }
 
     while (true) {
-        char c = *tokenizer->input;
-
-        if (!c) {
+        if (tokenizer->input == tokenizer->inputEnd) {
             if (tokenizer->tokenStatus == TOKEN_TOPLEVEL &&
                     tokenizer->wordStatus == WORDSTATUS_OPERATOR) {
                 delimit(tokenizer, OPERATOR);
@@ -95,9 +107,7 @@ enum TokenizerResult splitTokens(struct Tokenizer* tokenizer) {
                 return TOKENIZER_DONE;
             }
 
-            if (!tokenizer->readInput(&tokenizer->input, false,
-                    tokenizer->context)) {
-                tokenizer->input = "";
+            if (!readMoreInput(tokenizer, false)) {
                 if (tokenizer->tokenStatus == TOKEN_COMMENT) {
                     unnest(tokenizer);
                 } else if (tokenizer->tokenStatus == TOKEN_EOF) {
@@ -120,8 +130,12 @@ enum TokenizerResult splitTokens(struct Tokenizer* tokenizer) {
             continue;
         }
 
+        char c = *tokenizer->input;
+
         if (tokenizer->wordStatus == WORDSTATUS_HERE_DOC) {
-            if (readHereDocument(tokenizer)) {
+            bool finished = readHereDocument(tokenizer);
+            tokenizer->tokenStart = tokenizer->input;
+            if (finished) {
                 if (tokenizer->hereDocs[tokenizer->numHereDocs - 1].content) {
                     tokenizer->wordStatus = WORDSTATUS_NONE;
                 }
@@ -132,11 +146,56 @@ enum TokenizerResult splitTokens(struct Tokenizer* tokenizer) {
         }
 
         if (tokenizer->tokenStatus == TOKEN_COMMENT) {
-            if (c == '\n') {
+            const char* newline = memchr(tokenizer->input, '\n',
+                    tokenizer->inputEnd - tokenizer->input);
+            if (newline) {
+                tokenizer->input = newline;
                 unnest(tokenizer);
-                continue;
+            } else {
+                tokenizer->input = tokenizer->inputEnd;
+            }
+            tokenizer->tokenStart = tokenizer->input;
+            continue;
+        }
+
+        if (tokenizer->wordStatus == WORDSTATUS_DOLLAR_PAREN) {
+            tokenizer->wordStatus = WORDSTATUS_WORD;
+            if (c == '(') {
+                nest(tokenizer, TOKEN_ARITHMETIC);
+                goto appendAndNext;
+            }
+
+            // The command substitution is copied to the buffer while it is
+            // being parsed.
+            flushToken(tokenizer);
+            struct TokenSubstitution subst;
+            subst.offset = tokenizer->buffer.used;
+            subst.command = arenaAllocate(&tokenizer->arena,
+                    sizeof(struct CompleteCommand));
+            struct Parser parser;
+            initParser(&parser, readInput, tokenizer);
+            parser.tokenizer.quiet = tokenizer->quiet;
+            size_t inputRemaining;
+            enum ParserResult result = parseCommandSubstitution(&parser,
+                    subst.command, &inputRemaining);
+            freeParser(&parser);
+            if (result != PARSER_MATCH && result != PARSER_NO_CMD) {
+                return TOKENIZER_SYNTAX_ERROR;
+            }
+            tokenizer->input -= inputRemaining;
+            tokenizer->buffer.used -= inputRemaining;
+            tokenizer->tokenStart = tokenizer->input;
+
+            // Keep the parsed command so that the parser can attach it to
+            // the word.
+            if (result == PARSER_MATCH) {
+                subst.length = tokenizer->buffer.used - subst.offset;
+                arenaDefer(&tokenizer->arena, releaseCommand, subst.command);
+                arenaAddToArray(&tokenizer->arena,
+                        (void**) &tokenizer->substitutions,
+                        &tokenizer->numSubstitutions, &subst,
+                        sizeof(struct TokenSubstitution));
             }
-            tokenizer->input++;
             continue;
         }
 
@@ -144,8 +203,10 @@ enum TokenizerResult splitTokens(struct Tokenizer* tokenizer) {
         tokenizer->backslash = false;
 
         if (escaped && c == '\n') {
+            flushToken(tokenizer);
             tokenizer->buffer.used--;
             tokenizer->input++;
+            tokenizer->tokenStart = tokenizer->input;
             continue;
         }
 
@@ -161,8 +222,9 @@ enum TokenizerResult splitTokens(struct Tokenizer* tokenizer) {
         }
 
         if (tokenizer->wordStatus == WORDSTATUS_OPERATOR) {
-            if (!escaped && canContinueOperator(tokenizer->buffer.buffer,
-                    tokenizer->buffer.used, c)) {
+            size_t opLength;
+            const char* op = currentToken(tokenizer, &opLength);
+            if (!escaped && canContinueOperator(op, opLength, c)) {
                 goto appendAndNext;
             } else {
                 delimit(tokenizer, OPERATOR);
@@ -226,25 +288,34 @@ enum TokenizerResult splitTokens(struct Tokenizer* tokenizer) {
                     nest(tokenizer, TOKEN_PARAMETER_EXP);
                     goto appendAndNext;
                 } else if (c == '(') {
-                    appendToStringBuffer(&tokenizer->buffer, c);
-                    tokenizer->input++;
-                    struct Parser parser;
-                    initParser(&parser, readInput, tokenizer);
-                    size_t inputRemaining;
-                    enum ParserResult result = parseCommandSubstitution(&parser,
-                            NULL, &inputRemaining);
-                    freeParser(&parser);
-                    if (result != PARSER_MATCH && result != PARSER_NO_CMD) {
-                        return TOKENIZER_SYNTAX_ERROR;
-                    }
-                    tokenizer->input -= inputRemaining;
-                    tokenizer->buffer.used -= inputRemaining;
-                    continue;
+                    tokenizer->wordStatus = WORDSTATUS_DOLLAR_PAREN;
+                    goto appendAndNext;
                 } else {
                     tokenizer->wordStatus = WORDSTATUS_WORD;
                 }
             }
 
+            if (tokenizer->tokenStatus == TOKEN_ARITHMETIC ||
+                    tokenizer->tokenStatus == TOKEN_ARITHMETIC_PAREN) {
+                if (c == '(') {
+                    nest(tokenizer, TOKEN_ARITHMETIC_PAREN);
+                    goto appendAndNext;
+                } else if (c == ')') {
+                    if (tokenizer->tokenStatus == TOKEN_ARITHMETIC_PAREN) {
+                        unnest(tokenizer);
+                    } else {
+                        tokenizer->tokenStatus = TOKEN_ARITHMETIC_END;
+                    }
+                    goto appendAndNext;
+                }
+            }
+
+            if (tokenizer->tokenStatus == TOKEN_ARITHMETIC_END) {
+                if (c != ')') return TOKENIZER_SYNTAX_ERROR;
+                unnest(tokenizer);
+                goto appendAndNext;
+            }
+
             if (tokenizer->tokenStatus == TOKEN_PARAMETER_EXP && c == '}') {
                 unnest(tokenizer);
                 goto appendAndNext;
@@ -263,7 +334,8 @@ enum TokenizerResult splitTokens(struct Tokenizer* tokenizer) {
 
             if (tokenizer->tokenStatus == TOKEN_TOPLEVEL
                     && canBeginOperator(c)) {
-                if (tokenizer->buffer.used > 0) {
+                if (tokenizer->buffer.used > 0 ||
+                        tokenizer->tokenStart != tokenizer->input) {
                     enum TokenType type = (tokenizer->wordStatus ==
                             WORDSTATUS_NUMBER) ? IO_NUMBER : TOKEN;
                     delimit(tokenizer, type);
@@ -277,11 +349,14 @@ enum TokenizerResult splitTokens(struct Tokenizer* tokenizer) {
 
             if (tokenizer->tokenStatus == TOKEN_TOPLEVEL && isblank(c)) {
                 tokenizer->wordStatus = WORDSTATUS_NONE;
-                tokenizer->input++;
-                if (tokenizer->buffer.used > 0) {
+                bool haveToken = tokenizer->buffer.used > 0 ||
+                        tokenizer->tokenStart != tokenizer->input;
+                if (haveToken) {
                     delimit(tokenizer, TOKEN);
-                    return TOKENIZER_DONE;
                 }
+                tokenizer->input++;
+                tokenizer->tokenStart = tokenizer->input;
+                if (haveToken) return TOKENIZER_DONE;
                 continue;
             }
         }
@@ -290,6 +365,7 @@ enum TokenizerResult splitTokens(struct Tokenizer* tokenizer) {
                 tokenizer->wordStatus == WORDSTATUS_NONE && c == '#') {
             nest(tokenizer, TOKEN_COMMENT);
             tokenizer->input++;
+            tokenizer->tokenStart = tokenizer->input;
             continue;
         }
 
@@ -302,27 +378,20 @@ enum TokenizerResult splitTokens(struct Tokenizer* tokenizer) {
         }
 
 appendAndNext:
-        appendToStringBuffer(&tokenizer->buffer, c);
         tokenizer->input++;
     }
 }
 
 void freeTokenizer(struct Tokenizer* tokenizer) {
-    while (tokenizer->prev) {
-        unnest(tokenizer);
-    }
-
-    for (size_t i = 0; i < tokenizer->numTokens; i++) {
-        free(tokenizer->tokens[i].text);
-    }
-    free(tokenizer->tokens);
+    freeArena(&tokenizer->arena);
 
     for (size_t i = 0; i < tokenizer->numHereDocs; i++) {
         free(tokenizer->hereDocs[i].content);
         free(tokenizer->hereDocs[i].delimiter);
     }
     free(tokenizer->hereDocs);
-    free(tokenizer->buffer.buffer);
+    free(tokenizer->nestedStatus);
+    freeStringBuffer(&tokenizer->buffer);
 }
 
 static bool canBeginOperator(char c) {
@@ -350,32 +419,63 @@ static bool canContinueOperator(const char* s, size_t opLength, char c) {
     return false;
 }
 
+static const char* currentToken(struct Tokenizer* tokenizer, size_t* length) {
+    if (tokenizer->buffer.used == 0) {
+        *length = tokenizer->input - tokenizer->tokenStart;
+        return tokenizer->tokenStart;
+    }
+
+    flushToken(tokenizer);
+    *length = tokenizer->buffer.used;
+    return tokenizer->buffer.buffer;
+}
+
 static void delimit(struct Tokenizer* tokenizer, enum TokenType type) {
     assert(tokenizer->tokenStatus == TOKEN_TOPLEVEL);
 
-    if (tokenizer->buffer.used == 0) return;
+    size_t length;
+    const char* text = currentToken(tokenizer, &length);
+    if (length == 0) return;
 
     struct Token token;
     token.type = type;
-    token.text = finishStringBuffer(&tokenizer->buffer);
-    addToArray((void**) &tokenizer->tokens, &tokenizer->numTokens,
-            &token, sizeof(struct Token));
-    initStringBuffer(&tokenizer->buffer);
+    token.text = arenaStrndup(&tokenizer->arena, text, length);
+    token.substitutions = tokenizer->substitutions;
+    token.numSubstitutions = tokenizer->numSubstitutions;
+    tokenizer->substitutions = NULL;
+    tokenizer->numSubstitutions = 0;
+    arenaAddToArray(&tokenizer->arena, (void**) &tokenizer->tokens,
+            &tokenizer->numTokens, &token, sizeof(struct Token));
+    tokenizer->buffer.used = 0;
+    tokenizer->tokenStart = tokenizer->input;
 
     if (tokenizer->numHereDocs > 0 &&
             !tokenizer->hereDocs[tokenizer->numHereDocs - 1].delimiter) {
-        char* delimiter = removeQuotes(token.text, 0, NULL, 0, false);
+        char* delimiter = strdup(token.text);
+        if (!delimiter) err(1, "strdup");
+        removeQuotes(delimiter, 0, NULL, 0, false);
         tokenizer->hereDocs[tokenizer->numHereDocs - 1].delimiter = delimiter;
     }
 }
 
+static void flushToken(struct Tokenizer* tokenizer) {
+    appendBytesToStringBuffer(&tokenizer->buffer, tokenizer->tokenStart,
+            tokenizer->input - tokenizer->tokenStart);
+    tokenizer->tokenStart = tokenizer->input;
+}
+
 static void nest(struct Tokenizer* tokenizer, enum TokenStatus status) {
     tokenizer->wordStatus = WORDSTATUS_NONE;
-    struct TokenizerContext* prev = malloc(sizeof(struct TokenizerContext));
-    if (!prev) err(1, "malloc");
-    prev->prev = tokenizer->prev;
-    prev->tokenStatus = tokenizer->tokenStatus;
-    tokenizer->prev = prev;
+    if (tokenizer->nesting == tokenizer->nestedStatusSize) {
+        size_t newSize = tokenizer->nestedStatusSize ?
+                2 * tokenizer->nestedStatusSize : 8;
+        enum TokenStatus* newStatus = reallocarray(tokenizer->nestedStatus,
+                newSize, sizeof(enum TokenStatus));
+        if (!newStatus) err(1, "realloc");
+        tokenizer->nestedStatus = newStatus;
+        tokenizer->nestedStatusSize = newSize;
+    }
+    tokenizer->nestedStatus[tokenizer->nesting++] = tokenizer->tokenStatus;
     tokenizer->tokenStatus = status;
 }
 
@@ -389,19 +489,23 @@ static bool readHereDocument(struct Tokenizer* tokenizer) {
     size_t delimLength = strlen(delimiter);
     bool stripTabs = tokenizer->hereDocs[i].stripTabs;
 
-    while (*tokenizer->input) {
-        while (stripTabs && *tokenizer->input == '\t') {
+    while (tokenizer->input < tokenizer->inputEnd) {
+        while (stripTabs && tokenizer->input < tokenizer->inputEnd &&
+                *tokenizer->input == '\t') {
             tokenizer->input++;
         }
 
-        size_t lineLength = strcspn(tokenizer->input, "\n");
+        size_t available = tokenizer->inputEnd - tokenizer->input;
+        const char* newline = memchr(tokenizer->input, '\n', available);
+        size_t lineLength = newline ? (size_t) (newline - tokenizer->input) :
+                available;
         if (lineLength == delimLength && memcmp(tokenizer->input, delimiter,
                 lineLength) == 0) {
             tokenizer->hereDocs[i].content =
                     finishStringBuffer(&tokenizer->buffer);
             initStringBuffer(&tokenizer->buffer);
             tokenizer->input += lineLength;
-            if (*tokenizer->input) {
+            if (tokenizer->input < tokenizer->inputEnd) {
                 tokenizer->input++;
             }
             return true;
@@ -412,7 +516,7 @@ static bool readHereDocument(struct Tokenizer* tokenizer) {
         appendToStringBuffer(&tokenizer->buffer, '\n');
 
         tokenizer->input += lineLength;
-        if (*tokenizer->input) {
+        if (tokenizer->input < tokenizer->inputEnd) {
             tokenizer->input++;
         }
     }
@@ -420,11 +524,32 @@ static bool readHereDocument(struct Tokenizer* tokenizer) {
     return false;
 }
 
+static bool readMoreInput(struct Tokenizer* tokenizer, bool newCommand) {
+    // The old input might not remain valid.
+    if (tokenizer->tokenStart) {
+        flushToken(tokenizer);
+    }
+
+    size_t length;
+    if (!tokenizer->readInput(&tokenizer->input, &length, newCommand,
+            tokenizer->context)) {
+        tokenizer->input = "";
+        tokenizer->inputEnd = tokenizer->input;
+        tokenizer->tokenStart = tokenizer->input;
+        return false;
+    }
+    tokenizer->inputEnd = tokenizer->input + length;
+    tokenizer->tokenStart = tokenizer->input;
+    return true;
+}
+
+static void releaseCommand(void* command) {
+    // This does nothing if the parser has taken the command.
+    freeCompleteCommand(command);
+}
+
 static void unnest(struct Tokenizer* tokenizer) {
-    assert(tokenizer->prev);
+    assert(tokenizer->nesting > 0);
     tokenizer->wordStatus = WORDSTATUS_WORD;
-    struct TokenizerContext* prev = tokenizer->prev;
-    tokenizer->tokenStatus = prev->tokenStatus;
-    tokenizer->prev = prev->prev;
-    free(prev);
+    tokenizer->tokenStatus = tokenizer->nestedStatus[--tokenizer->nesting];
 }
@@ -1,4 +1,4 @@
-/* Copyright (c) 2018, 2019, 2020, 2022 Dennis Wölfing
+/* Copyright (c) 2018, 2019, 2020, 2022, 2026 Dennis Wölfing
  *
  * Permission to use, copy, modify, and/or distribute this software for any
  * purpose with or without fee is hereby granted, provided that the above
@@ -20,6 +20,7 @@
 #ifndef TOKENIZER_H
 #define TOKENIZER_H
 
+#include "arena.h"
 #include "stringbuffer.h"
 
 enum TokenType {
@@ -28,15 +29,32 @@ enum TokenType {
     TOKEN,
 };
 
+struct CompleteCommand;
+
+// A command substitution in a token that was already parsed by the tokenizer.
+struct TokenSubstitution {
+    // Offset and length of the text following "$(" in the token text.
+    size_t offset;
+    size_t length;
+    struct CompleteCommand* command;
+};
+
 struct Token {
     enum TokenType type;
     char* text;
+    struct TokenSubstitution* substitutions;
+    size_t numSubstitutions;
 };
 
 enum TokenStatus {
     TOKEN_TOPLEVEL,
     TOKEN_DOUBLE_QUOTED,
     TOKEN_PARAMETER_EXP,
+    TOKEN_ARITHMETIC,
+    // Parentheses nested in an arithmetic expansion.
+    TOKEN_ARITHMETIC_PAREN,
+    // The first of the two closing parentheses has been read.
+    TOKEN_ARITHMETIC_END,
 
     TOKEN_COMMENT,
     TOKEN_SINGLE_QUOTED,
@@ -49,6 +67,9 @@ enum WordStatus {
     WORDSTATUS_WORD,
     WORDSTATUS_OPERATOR,
     WORDSTATUS_DOLLAR_SIGN,
+    // "$(" was read. The next character decides whether this is a command
+    // substitution or an arithmetic expansion.
+    WORDSTATUS_DOLLAR_PAREN,
     WORDSTATUS_NUMBER,
     WORDSTATUS_HERE_DOC,
 };
@@ -59,11 +80,6 @@ enum TokenizerResult {
     TOKENIZER_SYNTAX_ERROR,
 };
 
-struct TokenizerContext {
-    struct TokenizerContext* prev;
-    enum TokenStatus tokenStatus;
-};
-
 struct HereDoc {
     char* content;
     char* delimiter;
@@ -71,23 +87,39 @@ struct HereDoc {
 };
 
 struct Tokenizer {
+    // Token texts are allocated in this arena.
+    struct Arena arena;
     bool backslash;
+    // Syntax errors are not reported when this is set.
+    bool quiet;
+    // The current token consists of the contents of the buffer followed by
+    // the input between tokenStart and input. The buffer is only used when
+    // the token cannot be copied from the input in one piece.
     struct StringBuffer buffer;
+    const char* tokenStart;
+    // Command substitutions in the current token.
+    struct TokenSubstitution* substitutions;
+    size_t numSubstitutions;
     size_t numTokens;
-    struct TokenizerContext* prev;
+    // Token status of the enclosing contexts.
+    enum TokenStatus* nestedStatus;
+    size_t nesting;
+    size_t nestedStatusSize;
     struct Token* tokens;
     size_t numHereDocs;
     struct HereDoc* hereDocs;
     enum TokenStatus tokenStatus;
     enum WordStatus wordStatus;
     const char* input;
-    bool (*readInput)(const char** str, bool newCommand, void* context);
+    const char* inputEnd;
+    bool (*readInput)(const char** str, size_t* length, bool newCommand,
+            void* context);
     void* context;
 };
 
 void initTokenizer(struct Tokenizer* tokenizer,
-        bool (*readInput)(const char** str, bool newCommand, void* context),
-        void* context);
+        bool (*readInput)(const char** str, size_t* length, bool newCommand,
+        void* context), void* context);
 enum TokenizerResult splitTokens(struct Tokenizer* tokenizer);
 void freeTokenizer(struct Tokenizer* tokenizer);
 
@@ -1,4 +1,4 @@
-/* Copyright (c) 2022, 2025 Dennis Wölfing
+/* Copyright (c) 2022, 2025, 2026 Dennis Wölfing
  *
  * Permission to use, copy, modify, and/or distribute this software for any
  * purpose with or without fee is hereby granted, provided that the above
@@ -42,12 +42,20 @@ enum {
     INVALID,
 };
 
+struct Trap {
+    char* action;
+    // The parsed action. This is NULL until the trap is first executed and
+    // while the command is being executed.
+    struct CompleteCommand* command;
+    size_t refcount;
+};
+
 bool executingTrap = false;
 volatile sig_atomic_t trapsPending;
 
 static sigset_t caughtSignals;
 static bool executingExitTrap = false;
-static char* traps[NSIG_MAX];
+static struct Trap* traps[NSIG_MAX];
 static int trapStates[NSIG_MAX];
 
 static void sigintHandler(int signo) {
@@ -59,35 +67,74 @@ static void signalHandler(int signum) {
     trapsPending = 1;
 }
 
-static bool readInputFromString(const char** str, bool newCommand,
-        void* context) {
+static bool readInputFromString(const char** str, size_t* length,
+        bool newCommand, void* context) {
     (void) newCommand;
 
     const char** word = context;
     if (!*word) return false;
     *str = *word;
+    *length = strlen(*word);
     *word = NULL;
     return true;
 }
 
-static void executeTrapAction(int condition) {
+static enum ParserResult parseTrapAction(const char* action,
+        struct CompleteCommand** result) {
+    struct CompleteCommand* command = malloc(sizeof(struct CompleteCommand));
+    if (!command) err(1, "malloc");
+
     struct Parser parser;
-    const char* context = traps[condition];
+    const char* context = action;
     initParser(&parser, readInputFromString, &context);
+    enum ParserResult parserResult = parse(&parser, command, true);
+    freeParser(&parser);
+
+    if (parserResult != PARSER_MATCH) {
+        free(command);
+        command = NULL;
+    }
+    *result = command;
+    return parserResult;
+}
+
+static void releaseTrap(struct Trap* trap) {
+    if (trap && --trap->refcount == 0) {
+        if (trap->command) {
+            freeCompleteCommand(trap->command);
+            free(trap->command);
+        }
+        free(trap->action);
+        free(trap);
+    }
+}
 
-    struct CompleteCommand command;
-    enum ParserResult parserResult = parse(&parser, &command, true);
+static void executeTrapAction(int condition) {
+    struct Trap* trap = traps[condition];
+    if (!trap) return;
 
-    if (parserResult == PARSER_MATCH) {
+    // The command is owned by the currentCommand chain while it is being
+    // executed. The trap might be changed by its own action.
+    trap->refcount++;
+    struct CompleteCommand* command = trap->command;
+    trap->command = NULL;
+
+    if (command || parseTrapAction(trap->action, &command) == PARSER_MATCH) {
         int status = lastStatus;
         executingTrap = true;
-        execute(&command);
+        execute(command, false);
         executingTrap = false;
-        freeCompleteCommand(&command);
         lastStatus = status;
+
+        if (!trap->command) {
+            trap->command = command;
+        } else {
+            freeCompleteCommand(command);
+            free(command);
+        }
     }
 
-    freeParser(&parser);
+    releaseTrap(trap);
 }
 
 void blockTraps(const sigset_t* mask) {
@@ -152,11 +199,31 @@ void initializeTraps(void) {
     }
 }
 
-void resetSignals(void) {
+// Returns the signals that resetSignals() resets to their default action.
+void getSignalsToReset(sigset_t* set) {
+    sigemptyset(set);
     for (int i = 1; i < NSIG_MAX; i++) {
         if (trapStates[i] == INVALID) continue;
 
         if (trapStates[i] != IGNORED && trapStates[i] != ALWAYS_IGNORED) {
+            sigaddset(set, i);
+        }
+    }
+}
+
+// Returns whether an action is set for any trap condition.
+bool hasTraps(void) {
+    for (int i = 0; i < NSIG_MAX; i++) {
+        if (trapStates[i] == TRAPPED) return true;
+    }
+    return false;
+}
+
+void resetSignals(void) {
+    sigset_t set;
+    getSignalsToReset(&set);
+    for (int i = 1; i < NSIG_MAX; i++) {
+        if (trapStates[i] != INVALID && sigismember(&set, i)) {
             struct sigaction sa;
             sa.sa_handler = SIG_DFL;
             sa.sa_flags = 0;
@@ -176,7 +243,7 @@ void resetTraps(void) {
 
     for (int i = 0; i < NSIG_MAX; i++) {
         if (trapStates[i] == TRAPPED) {
-            free(traps[i]);
+            releaseTrap(traps[i]);
             traps[i] = NULL;
             trapStates[i] = DEFAULT;
 
@@ -208,6 +275,7 @@ static int parseCondition(const char* name) {
 }
 
 int trap(int argc, char* argv[]) {
+    bool check = false;
     bool print = false;
     int i;
     for (i = 1; i < argc; i++) {
@@ -217,7 +285,9 @@ int trap(int argc, char* argv[]) {
             break;
         }
         for (size_t j = 1; argv[i][j]; j++) {
-            if (argv[i][j] == 'p') {
+            if (argv[i][j] == 'c') {
+                check = true;
+            } else if (argv[i][j] == 'p') {
                 print = true;
             } else {
                 warnx("trap: invalid option '-%c'", argv[i][j]);
@@ -235,7 +305,7 @@ int trap(int argc, char* argv[]) {
             if (trapStates[i] == INVALID) continue;
 
             if (trapStates[i] != DEFAULT || print) {
-                const char* action = traps[i] ? traps[i] : "-";
+                const char* action = traps[i] ? traps[i]->action : "-";
                 char buffer[SIG2STR_MAX];
                 if (i == 0) {
                     strcpy(buffer, "EXIT");
@@ -258,7 +328,8 @@ int trap(int argc, char* argv[]) {
                 continue;
             }
 
-            const char* action = traps[condition] ? traps[condition] : "-";
+            const char* action = traps[condition] ?
+                    traps[condition]->action : "-";
             char buffer[SIG2STR_MAX];
             if (condition == 0) {
                 strcpy(buffer, "EXIT");
@@ -282,6 +353,25 @@ int trap(int argc, char* argv[]) {
         i++;
     }
 
+    struct Trap* newTrap = NULL;
+    if (action && strcmp(action, "-") != 0) {
+        newTrap = malloc(sizeof(struct Trap));
+        if (!newTrap) err(1, "malloc");
+        newTrap->action = strdup(action);
+        if (!newTrap->action) err(1, "malloc");
+        newTrap->command = NULL;
+        // Released at the end of this function.
+        newTrap->refcount = 1;
+
+        // With -c syntax errors are reported now instead of when the trap is
+        // executed.
+        if (check && *action && parseTrapAction(action, &newTrap->command) ==
+                PARSER_SYNTAX) {
+            releaseTrap(newTrap);
+            return 1;
+        }
+    }
+
     for (; i < argc; i++) {
         int condition = parseCondition(argv[i]);
         if (condition < 0) {
@@ -290,24 +380,18 @@ int trap(int argc, char* argv[]) {
             continue;
         }
 
-        if (!action || strcmp(action, "-") == 0) {
-            free(traps[condition]);
-            traps[condition] = NULL;
-            if (trapStates[condition] != ALWAYS_IGNORED) {
+        releaseTrap(traps[condition]);
+        traps[condition] = newTrap;
+        if (newTrap) {
+            newTrap->refcount++;
+        }
+
+        if (trapStates[condition] != ALWAYS_IGNORED) {
+            if (!newTrap) {
                 trapStates[condition] = DEFAULT;
-            }
-        } else if (*action == '\0') {
-            free(traps[condition]);
-            traps[condition] = strdup(action);
-            if (!traps[condition]) err(1, "malloc");
-            if (trapStates[condition] != ALWAYS_IGNORED) {
+            } else if (*action == '\0') {
                 trapStates[condition] = IGNORED;
-            }
-        } else {
-            free(traps[condition]);
-            traps[condition] = strdup(action);
-            if (!traps[condition]) err(1, "malloc");
-            if (trapStates[condition] != ALWAYS_IGNORED) {
+            } else {
                 trapStates[condition] = TRAPPED;
             }
         }
@@ -346,6 +430,7 @@ int trap(int argc, char* argv[]) {
         }
     }
 
+    releaseTrap(newTrap);
     return status;
 }
 
@@ -1,4 +1,4 @@
-/* Copyright (c) 2022, 2025 Dennis Wölfing
+/* Copyright (c) 2022, 2025, 2026 Dennis Wölfing
  *
  * Permission to use, copy, modify, and/or distribute this software for any
  * purpose with or without fee is hereby granted, provided that the above
@@ -30,6 +30,8 @@ extern volatile sig_atomic_t trapsPending;
 void blockTraps(const sigset_t* mask);
 void executeTraps(void);
 noreturn void exitShell(int status);
+void getSignalsToReset(sigset_t* set);
+bool hasTraps(void);
 void initializeTraps(void);
 void resetSignals(void);
 void resetTraps(void);
@@ -1,4 +1,4 @@
-/* Copyright (c) 2019, 2020, 2021, 2022, 2025 Dennis Wölfing
+/* Copyright (c) 2019, 2020, 2021, 2022, 2025, 2026 Dennis Wölfing
  *
  * Permission to use, copy, modify, and/or distribute this software for any
  * purpose with or without fee is hereby granted, provided that the above
@@ -34,11 +34,11 @@ char** arguments;
 int numArguments;
 struct ShellVar* variables;
 size_t variablesAllocated;
+size_t variablesPushed;
 
 // This buffer is large enough to contain any $- value or any 32 bit integer.
 static char buffer[15];
 static struct ShellVar* pushedVars;
-static size_t variablesPushed;
 
 const char* getVariable(const char* name) {
     if (isdigit(*name)) {
@@ -176,6 +176,43 @@ void pushVariable(const char* name, const char* value) {
     variablesPushed++;
 }
 
+// Restores a variable saved by saveVariable and frees the saved state.
+void restoreVariable(struct SavedVariable* saved) {
+    if (!saved->exists) {
+        unsetVariable(saved->name);
+    } else if (saved->exported) {
+        if (!saved->value) unsetenv(saved->name);
+        setVariable(saved->name, saved->value, true);
+    } else {
+        setVariable(saved->name, saved->value, false);
+    }
+
+    free(saved->name);
+    free(saved->value);
+}
+
+void saveVariable(const char* name, struct SavedVariable* saved) {
+    saved->name = strdup(name);
+    if (!saved->name) err(1, "strdup");
+    saved->value = NULL;
+    saved->exists = false;
+    saved->exported = false;
+
+    for (size_t i = 0; i < variablesAllocated; i++) {
+        struct ShellVar* var = &variables[i];
+        if (strcmp(name, var->name) == 0) {
+            saved->exists = true;
+            saved->exported = !var->value;
+            const char* value = var->value ? var->value : getenv(name);
+            if (value) {
+                saved->value = strdup(value);
+                if (!saved->value) err(1, "strdup");
+            }
+            break;
+        }
+    }
+}
+
 void setVariable(const char* name, const char* value, bool export) {
     for (size_t i = 0; i < variablesAllocated; i++) {
         struct ShellVar* var = &variables[i];
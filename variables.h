@@ -1,4 +1,4 @@
-/* Copyright (c) 2019, 2020, 2021, 2022, 2025 Dennis Wölfing
+/* Copyright (c) 2019, 2020, 2021, 2022, 2025, 2026 Dennis Wölfing
  *
  * Permission to use, copy, modify, and/or distribute this software for any
  * purpose with or without fee is hereby granted, provided that the above
@@ -28,10 +28,18 @@ struct ShellVar {
     char* value;
 };
 
+struct SavedVariable {
+    char* name;
+    char* value;
+    bool exists;
+    bool exported;
+};
+
 extern char** arguments;
 extern int numArguments;
 extern struct ShellVar* variables;
 extern size_t variablesAllocated;
+extern size_t variablesPushed;
 
 const char* getVariable(const char* name);
 void initializeVariables(void);
@@ -39,6 +47,8 @@ bool isRegularVariableName(const char* s);
 void popVariables(void);
 void printVariables(bool exported);
 void pushVariable(const char* name, const char* value);
+void restoreVariable(struct SavedVariable* saved);
+void saveVariable(const char* name, struct SavedVariable* saved);
 void setVariable(const char* name, const char* value, bool export);
 void unsetVariable(const char* name);
 
@@ -0,0 +1,493 @@
+/* Copyright (c) 2026 Dennis Wölfing
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* word.c
+ * Lexing of words for expansion.
+ */
+
+#include <config.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arith.h"
+#include "parser.h"
+#include "stringbuffer.h"
+#include "variables.h"
+#include "word.h"
+
+struct Lexer {
+    struct Arena* arena;
+    bool noQuotes;
+    // Token containing the word, or NULL.
+    struct Token* token;
+};
+
+static void addPart(struct Lexer* lexer, struct Word* word,
+        struct WordPart* part);
+static void addText(struct Lexer* lexer, struct Word* word, const char* begin,
+        const char* end);
+static const char* invalid(struct Lexer* lexer, struct Word* word,
+        const char* command, bool oldStyle);
+static bool isPositionalParameter(const char* s);
+static bool isSpecialParameter(char c);
+static const char* lexArithmetic(struct Lexer* lexer, struct Word* word,
+        const char* p, size_t offset, bool doubleQuoted);
+static const char* lexBackquotedCommand(struct Lexer* lexer,
+        struct Word* word, const char* p, bool doubleQuoted);
+static const char* lexCommandSubstitution(struct Lexer* lexer,
+        struct Word* word, const char* p, size_t offset, bool doubleQuoted);
+static const char* lexDollar(struct Lexer* lexer, struct Word* word,
+        const char* p, size_t offset, bool doubleQuoted);
+static const char* lexParameterExpansion(struct Lexer* lexer,
+        struct Word* word, const char* p, size_t offset, bool doubleQuoted);
+static struct Word* lexText(struct Lexer* lexer, const char* text,
+        size_t offset);
+static char* readOldCommandSubst(const char** word);
+static bool readInputFromString(const char** str, size_t* length,
+        bool newCommand, void* context);
+static void releaseCommand(void* command);
+
+struct Word* lexWord(struct Arena* arena, const char* text, bool noQuotes,
+        struct Token* token) {
+    struct Lexer lexer;
+    lexer.arena = arena;
+    lexer.noQuotes = noQuotes;
+    lexer.token = token;
+    return lexText(&lexer, text, 0);
+}
+
+void reportInvalidCommand(const struct WordPart* part) {
+    if (!part->invalidCommand) return;
+
+    // Parse the command again to print the syntax error.
+    struct Parser parser;
+    struct CompleteCommand command;
+    const char* context = part->invalidCommand;
+    initParser(&parser, readInputFromString, &context);
+    enum ParserResult result;
+    if (part->oldStyle) {
+        result = parse(&parser, &command, true);
+    } else {
+        size_t inputRemaining;
+        result = parseCommandSubstitution(&parser, &command, &inputRemaining);
+    }
+    freeParser(&parser);
+    if (result == PARSER_MATCH) {
+        freeCompleteCommand(&command);
+    }
+}
+
+static void addPart(struct Lexer* lexer, struct Word* word,
+        struct WordPart* part) {
+    if (part->type != WORDPART_TEXT) {
+        word->literal = false;
+    }
+    // The arena of the substituted command is freed with the word.
+    if (part->type == WORDPART_COMMAND && part->command) {
+        arenaDefer(lexer->arena, releaseCommand, part->command);
+    }
+    arenaAddToArray(lexer->arena, (void**) &word->parts, &word->numParts,
+            part, sizeof(struct WordPart));
+}
+
+static void addText(struct Lexer* lexer, struct Word* word, const char* begin,
+        const char* end) {
+    if (begin == end) return;
+    struct WordPart part;
+    part.type = WORDPART_TEXT;
+    part.doubleQuoted = false;
+    part.text = begin;
+    part.length = end - begin;
+    addPart(lexer, word, &part);
+}
+
+static const char* invalid(struct Lexer* lexer, struct Word* word,
+        const char* command, bool oldStyle) {
+    struct WordPart part;
+    part.type = WORDPART_INVALID;
+    part.doubleQuoted = false;
+    part.invalidCommand = command;
+    part.oldStyle = oldStyle;
+    addPart(lexer, word, &part);
+    return NULL;
+}
+
+static bool isPositionalParameter(const char* s) {
+    do {
+        if (!isdigit(*s)) return false;
+    } while (*++s);
+    return true;
+}
+
+static bool isSpecialParameter(char c) {
+    return c != '\0' && strchr("!#$*-?@", c);
+}
+
+static const char* lexArithmetic(struct Lexer* lexer, struct Word* word,
+        const char* p, size_t offset, bool doubleQuoted) {
+    // Find the closing parentheses. Parentheses in quotes or in nested
+    // substitutions do not count.
+    size_t depth = 0;
+    char quote = '\0';
+    size_t length;
+    for (length = 0; true; length++) {
+        char c = p[length];
+        if (!c) return invalid(lexer, word, NULL, false);
+        if (c == '\\' && quote != '\'') {
+            if (p[length + 1]) length++;
+        } else if (quote) {
+            if (c == quote) quote = '\0';
+        } else if (c == '\'' || c == '"' || c == '`') {
+            quote = c;
+        } else if (c == '(') {
+            depth++;
+        } else if (c == ')') {
+            if (depth == 0) break;
+            depth--;
+        }
+    }
+    if (p[length + 1] != ')') return invalid(lexer, word, NULL, false);
+
+    struct WordPart part;
+    part.type = WORDPART_ARITHMETIC;
+    part.doubleQuoted = doubleQuoted;
+    bool noQuotes = lexer->noQuotes;
+    lexer->noQuotes = true;
+    part.expression = lexText(lexer, arenaStrndup(lexer->arena, p, length),
+            offset);
+    lexer->noQuotes = noQuotes;
+
+    // Expressions without substitutions are parsed only once.
+    part.arithmetic = NULL;
+    const struct Word* expression = part.expression;
+    if ((expression->numParts == 0 || (expression->numParts == 1 &&
+            expression->parts[0].type == WORDPART_TEXT)) &&
+            !strchr(expression->text, '\\')) {
+        part.arithmetic = parseArithmetic(lexer->arena, expression->text,
+                true);
+    }
+    addPart(lexer, word, &part);
+    return p + length + 2;
+}
+
+static const char* lexBackquotedCommand(struct Lexer* lexer,
+        struct Word* word, const char* p, bool doubleQuoted) {
+    char* commandString = readOldCommandSubst(&p);
+    if (!commandString) return invalid(lexer, word, NULL, true);
+
+    struct Parser parser;
+    struct CompleteCommand command;
+    const char* context = commandString;
+    initParser(&parser, readInputFromString, &context);
+    parser.tokenizer.quiet = true;
+    enum ParserResult result = parse(&parser, &command, true);
+    freeParser(&parser);
+
+    if (result != PARSER_MATCH && result != PARSER_NO_CMD) {
+        char* body = arenaStrdup(lexer->arena, commandString);
+        free(commandString);
+        return invalid(lexer, word, body, true);
+    }
+    free(commandString);
+
+    struct WordPart part;
+    part.type = WORDPART_COMMAND;
+    part.doubleQuoted = doubleQuoted;
+    part.command = NULL;
+    if (result == PARSER_MATCH) {
+        part.command = arenaAllocate(lexer->arena,
+                sizeof(struct CompleteCommand));
+        *part.command = command;
+    }
+    addPart(lexer, word, &part);
+    return p;
+}
+
+static const char* lexCommandSubstitution(struct Lexer* lexer,
+        struct Word* word, const char* p, size_t offset, bool doubleQuoted) {
+    struct WordPart part;
+    part.type = WORDPART_COMMAND;
+    part.doubleQuoted = doubleQuoted;
+    size_t available = strlen(p);
+
+    // Take the command if the tokenizer has already parsed it.
+    struct Token* token = lexer->token;
+    for (size_t i = 0; token && i < token->numSubstitutions; i++) {
+        struct TokenSubstitution* subst = &token->substitutions[i];
+        if (subst->command && subst->offset == offset &&
+                subst->length <= available) {
+            part.command = arenaAllocate(lexer->arena,
+                    sizeof(struct CompleteCommand));
+            *part.command = *subst->command;
+            initArena(&subst->command->arena);
+            subst->command = NULL;
+            addPart(lexer, word, &part);
+            return p + subst->length;
+        }
+    }
+
+    struct Parser parser;
+    struct CompleteCommand command;
+    const char* context = p;
+    initParser(&parser, readInputFromString, &context);
+    parser.tokenizer.quiet = true;
+    size_t inputRemaining = 0;
+    enum ParserResult result = parseCommandSubstitution(&parser, &command,
+            &inputRemaining);
+    freeParser(&parser);
+
+    if (result == PARSER_MATCH) {
+        part.command = arenaAllocate(lexer->arena,
+                sizeof(struct CompleteCommand));
+        *part.command = command;
+    } else if (result == PARSER_NO_CMD) {
+        part.command = NULL;
+    } else {
+        return invalid(lexer, word, p, false);
+    }
+    addPart(lexer, word, &part);
+    return p + available - inputRemaining;
+}
+
+static const char* lexDollar(struct Lexer* lexer, struct Word* word,
+        const char* p, size_t offset, bool doubleQuoted) {
+    char c = *p;
+    if (c == '{') {
+        return lexParameterExpansion(lexer, word, p + 1, offset + 1,
+                doubleQuoted);
+    } else if (c == '(' && p[1] == '(') {
+        return lexArithmetic(lexer, word, p + 2, offset + 2, doubleQuoted);
+    } else if (c == '(') {
+        return lexCommandSubstitution(lexer, word, p + 1, offset + 1,
+                doubleQuoted);
+    }
+
+    struct Parameter* param = arenaAllocate(lexer->arena,
+            sizeof(struct Parameter));
+    param->argument = NULL;
+    param->op = '\0';
+    param->nullMeansUnset = false;
+    param->greedy = false;
+    param->length = false;
+    param->allArguments = c == '*' || c == '@';
+
+    size_t nameLength = 1;
+    if (isalpha(c) || c == '_') {
+        while (isalnum(p[nameLength]) || p[nameLength] == '_') {
+            nameLength++;
+        }
+    }
+    param->name = arenaStrndup(lexer->arena, p, nameLength);
+
+    struct WordPart part;
+    part.type = WORDPART_PARAMETER;
+    part.doubleQuoted = doubleQuoted;
+    part.parameter = param;
+    addPart(lexer, word, &part);
+    return p + nameLength;
+}
+
+static const char* lexParameterExpansion(struct Lexer* lexer,
+        struct Word* word, const char* p, size_t offset, bool doubleQuoted) {
+    // TODO: Handle ${@} and ${*}.
+    const char* begin = p;
+    if (*p == '}' || *p == '\0') return invalid(lexer, word, NULL, false);
+
+    struct Parameter* param = arenaAllocate(lexer->arena,
+            sizeof(struct Parameter));
+    param->argument = NULL;
+    param->op = '\0';
+    param->nullMeansUnset = false;
+    param->greedy = false;
+    param->length = false;
+    param->allArguments = false;
+
+    if (p[0] == '#') {
+        if (p[1] == '}' || p[1] == ':' || ((p[1] == '-' || p[1] == '=' ||
+                p[1] == '?' || p[1] == '+') && p[2] != '}')) {
+            // The expansion refers to the $# variable.
+        } else {
+            param->length = true;
+            p++;
+            if (*p == '\0') return invalid(lexer, word, NULL, false);
+        }
+    }
+
+    size_t nameLength = strcspn(p + 1, "#%+-:=?}") + 1;
+    param->name = arenaStrndup(lexer->arena, p, nameLength);
+    if (!isRegularVariableName(param->name) &&
+            !isPositionalParameter(param->name) &&
+            !(nameLength == 1 && isSpecialParameter(*param->name))) {
+        return invalid(lexer, word, NULL, false);
+    }
+    p += nameLength;
+
+    if (*p != '}') {
+        param->nullMeansUnset = *p == ':';
+        if (param->nullMeansUnset) p++;
+        if (*p == '\0') return invalid(lexer, word, NULL, false);
+        char op = *p++;
+
+        size_t braces = 0;
+        size_t length;
+        for (length = 0; true; length++) {
+            if (!p[length]) return invalid(lexer, word, NULL, false);
+            if (p[length] == '$' && p[length + 1] == '{') {
+                braces++;
+            }
+            if (p[length] == '}') {
+                if (braces == 0) break;
+                braces--;
+            }
+        }
+
+        const char* argument = p;
+        p += length;
+        if (op == '%' || op == '#') {
+            if (param->nullMeansUnset) {
+                return invalid(lexer, word, NULL, false);
+            }
+            param->greedy = *argument == op;
+            if (param->greedy) {
+                argument++;
+                length--;
+            }
+        } else if (op != '-' && op != '=' && op != '?' && op != '+') {
+            // Other operators are ignored.
+            op = '\0';
+        }
+
+        if (op) {
+            param->op = op;
+            param->argument = lexText(lexer,
+                    arenaStrndup(lexer->arena, argument, length),
+                    offset + (argument - begin));
+        }
+    }
+
+    struct WordPart part;
+    part.type = WORDPART_PARAMETER;
+    part.doubleQuoted = doubleQuoted;
+    part.parameter = param;
+    addPart(lexer, word, &part);
+    return p + 1;
+}
+
+static struct Word* lexText(struct Lexer* lexer, const char* text,
+        size_t offset) {
+    struct Word* word = arenaAllocate(lexer->arena, sizeof(struct Word));
+    word->parts = NULL;
+    word->numParts = 0;
+    word->literal = *text != '\0';
+    word->text = text;
+
+    bool escaped = false;
+    bool singleQuote = false;
+    bool doubleQuote = false;
+
+    const char* begin = text;
+    const char* p = text;
+    while (*p) {
+        char c = *p++;
+
+        if (!singleQuote && c == '\\') {
+            escaped = !escaped;
+            word->literal = false;
+            continue;
+        } else if (!escaped && !lexer->noQuotes && !doubleQuote && c == '\'') {
+            singleQuote = !singleQuote;
+            word->literal = false;
+        } else if (!escaped && !lexer->noQuotes && !singleQuote && c == '"') {
+            doubleQuote = !doubleQuote;
+            word->literal = false;
+        } else if (!escaped && !singleQuote && c == '$' && (*p == '{' ||
+                *p == '(' || isalnum(*p) || *p == '_' ||
+                isSpecialParameter(*p))) {
+            addText(lexer, word, begin, p - 1);
+            p = lexDollar(lexer, word, p, offset + (p - text), doubleQuote);
+            if (!p) return word;
+            begin = p;
+            continue;
+        } else if (!escaped && !singleQuote && c == '`') {
+            addText(lexer, word, begin, p - 1);
+            p = lexBackquotedCommand(lexer, word, p, doubleQuote);
+            if (!p) return word;
+            begin = p;
+            continue;
+        } else if (c == '*' || c == '?' || c == '[') {
+            word->literal = false;
+        }
+        escaped = false;
+    }
+
+    addText(lexer, word, begin, p);
+    return word;
+}
+
+static char* readOldCommandSubst(const char** word) {
+    struct StringBuffer sb;
+    initStringBuffer(&sb);
+
+    bool escaped = false;
+    while (**word) {
+        if (**word == '\\') {
+            if (escaped) {
+                appendToStringBuffer(&sb, '\\');
+                escaped = false;
+            } else {
+                escaped = true;
+            }
+        } else if (**word == '`') {
+            if (escaped) {
+                appendToStringBuffer(&sb, '`');
+                escaped = false;
+            } else {
+                (*word)++;
+                return finishStringBuffer(&sb);
+            }
+        } else if (**word == '$') {
+            appendToStringBuffer(&sb, '$');
+            escaped = false;
+        } else {
+            if (escaped) {
+                appendToStringBuffer(&sb, '\\');
+                escaped = false;
+            }
+            appendToStringBuffer(&sb, **word);
+        }
+
+        (*word)++;
+    }
+
+    freeStringBuffer(&sb);
+    return NULL;
+}
+
+static bool readInputFromString(const char** str, size_t* length,
+        bool newCommand, void* context) {
+    (void) newCommand;
+
+    const char** word = context;
+    if (!*word) return false;
+    *str = *word;
+    *length = strlen(*word);
+    *word = NULL;
+    return true;
+}
+
+static void releaseCommand(void* command) {
+    freeArena(&((struct CompleteCommand*) command)->arena);
+}
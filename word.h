@@ -0,0 +1,93 @@
+/* Copyright (c) 2026 Dennis Wölfing
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* word.h
+ * Lexed words.
+ */
+
+#ifndef WORD_H
+#define WORD_H
+
+#include <stdbool.h>
+#include "arena.h"
+#include "tokenizer.h"
+
+struct Arithmetic;
+
+enum WordPartType {
+    // Text that is copied unchanged, including any quoting characters.
+    WORDPART_TEXT,
+    WORDPART_PARAMETER,
+    WORDPART_COMMAND,
+    WORDPART_ARITHMETIC,
+    // An invalid substitution. Expansion fails when it is reached.
+    WORDPART_INVALID,
+};
+
+struct Parameter {
+    char* name;
+    // The word following the operator, or NULL.
+    struct Word* argument;
+    // One of '-', '=', '?', '+', '%' and '#', or '\0' if there is none.
+    char op;
+    bool nullMeansUnset;
+    bool greedy;
+    bool length;
+    // $@ or $* without braces.
+    bool allArguments;
+};
+
+struct WordPart {
+    enum WordPartType type;
+    bool doubleQuoted;
+    union {
+        struct {
+            const char* text;
+            size_t length;
+        };
+        struct Parameter* parameter;
+        struct {
+            // NULL if the command substitution is empty.
+            struct CompleteCommand* command;
+        };
+        struct {
+            // The expression before its substitutions are expanded.
+            struct Word* expression;
+            // The parsed expression if it contains no substitutions.
+            struct Arithmetic* arithmetic;
+        };
+        struct {
+            // Command that failed to parse, or NULL.
+            const char* invalidCommand;
+            bool oldStyle;
+        };
+    };
+};
+
+struct Word {
+    struct WordPart* parts;
+    size_t numParts;
+    // The word contains no expansions, quotes or pattern characters.
+    bool literal;
+    const char* text;
+};
+
+// Command substitutions that the tokenizer has already parsed are taken from
+// the token, which may be NULL.
+struct Word* lexWord(struct Arena* arena, const char* text, bool noQuotes,
+        struct Token* token);
+void reportInvalidCommand(const struct WordPart* part);
+
+#endif